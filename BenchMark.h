@@ -2,11 +2,17 @@
 #define HHBENCH_H
 
 #include <arpa/inet.h> 
+#include <pthread.h>
 #include <netinet/in.h> 
 #include <vector>
 #include <fstream>
+#include <sstream>
+#include <unordered_set>
+
+#include "Allocation.h"
 
 #include "MMap.h"
+#include "Generator.h"
 #include "CocoSketch.h"
 #include "UnivMon.h"
 #include "Elastic.h"
@@ -22,6 +28,17 @@
 #include "TwoFASketch.h"
 #include "TightSketch.h"
 #include "OurSketch2.h"
+#include "SlidingWindow.h"
+#include "EpochManager.h"
+#include "Snapshot.h"
+#include "MultiKey.h"
+#include "HHH.h"
+#include "HeavyChanger.h"
+#include "SharedCocoSketch.h"
+#include "Aggregator.h"
+#include "Registry.h"
+#include "Cardinality.h"
+#include "SuperSpreader.h"
 
 /* Modify SketchType to run on difference sketch */ 
 #define SketchType TightSketch
@@ -29,12 +46,41 @@
 class BenchMark{
 public:
 
-    BenchMark(std::string PATH, std::string name){
+    /* WEIGHTED: the file holds PACKET records (5-tuple and packet length) instead of bare TUPLES */
+    BenchMark(std::string PATH, std::string name, bool WEIGHTED = false){
         fileName = name;
 
         result = Load(PATH.c_str());
-        dataset = (TUPLES*)result.start;
-        length = result.length / sizeof(TUPLES);
+        if(!WEIGHTED){
+            dataset = (TUPLES*)result.start;
+            length = result.length / sizeof(TUPLES);
+        }
+        else{
+            PACKET* packets = (PACKET*)result.start;
+            length = result.length / sizeof(PACKET);
+            tuples.resize(length);
+            weights.resize(length);
+            for(uint64_t i = 0; i < length; ++i){
+                tuples[i] = packets[i].tuple;
+                weights[i] = packets[i].length;
+            }
+            dataset = tuples.data();
+        }
+
+        for(uint64_t i = 0; i < length; ++i){
+            tuplesMp[dataset[i]] += 1;
+        }
+    }
+
+    /* The first PACKETS packets of a synthetic trace, generated on THREADS threads */
+    BenchMark(const Generator& generator, uint64_t PACKETS, uint32_t THREADS, std::string name){
+        fileName = name;
+        result = {nullptr, 0};
+
+        tuples.resize(PACKETS);
+        generator.Fill(tuples.data(), PACKETS, THREADS);
+        dataset = tuples.data();
+        length = PACKETS;
 
         for(uint64_t i = 0; i < length; ++i){
             tuplesMp[dataset[i]] += 1;
@@ -42,7 +88,13 @@ public:
     }
 
     ~BenchMark(){
-        UnLoad(result);
+        if(result.start)
+            UnLoad(result);
+    }
+
+    /* Hash seed and random stream of every sketch the benches create */
+    void Seed(uint32_t _seed){
+        seed = _seed;
     }
 
     void HHBench(uint32_t MEMORY, double alpha) {
@@ -52,40 +104,1591 @@ public:
         COUNT_TYPE threshold = alpha * length;
 
         // tupleSketch = new TwoStage<TUPLES>(MEMORY, threshold); /* TwoStage */
-        tupleSketch = new SketchType<TUPLES>(MEMORY); /* Sketch */
+        tupleSketch = Seeded(new SketchType<TUPLES>(MEMORY)); /* Sketch */
+
+        RunHH(tupleSketch, threshold, alpha);
+        // printTopK(tuplesMp, 10);
+
+        delete tupleSketch;
+    }
+
+    /* HHBench with the flow key derived from each packet, e.g. srcIP or the IPv6 form */
+    template<typename KEY>
+    void KeyBench(uint32_t MEMORY, double alpha, std::function<KEY(const TUPLES&)> convert) {
+        COUNT_TYPE threshold = alpha * length;
+
+        std::vector<KEY> keys(length);
+        std::unordered_map<KEY, COUNT_TYPE> keysMp;
+        for (uint64_t j = 0; j < length; ++j) {
+            keys[j] = convert(dataset[j]);
+            keysMp[keys[j]] += 1;
+        }
+
+        Abstract<KEY>* keySketch = Seeded(new SketchType<KEY>(MEMORY));
+
+        std::cout << "+------------------------------------------------+" << std::endl;
+        std::cout << "- " << keySketch->name << " (" << sizeof(KEY) << "-byte key, "
+                  << keysMp.size() << " flows)" << std::endl;
+
+        TP start, end;
+        std::cout << "- Average Time Per Operation" << std::endl;
+
+        start = now();
+        for (uint64_t j = 0; j < length; ++j) {
+            keySketch->Insert(keys[j]);
+        }
+        end = now();
+        std::cout << "    Insert: " << (durationms(end, start) / length) << " ms" << std::endl;
+
+        start = now();
+        for (uint64_t j = 0; j < length; ++j) {
+            keySketch->Query(keys[j]);
+        }
+        end = now();
+        std::cout << "    Query: " << (durationms(end, start) / length) << " ms" << std::endl;
+
+        std::unordered_map<KEY, COUNT_TYPE> estKey = keySketch->AllQuery();
+        CompareHH(estKey, keysMp, threshold, alpha);
+        std::cout << "+------------------------------------------------+" << std::endl;
+
+        delete keySketch;
+    }
+
+    /* Five partial keys: one pass per key vs. one pass for all of them */
+    void MultiKeyBench(uint32_t MEMORY, double alpha) {
+        COUNT_TYPE threshold = alpha * length;
+        std::vector<KeyMask> masks = {KeyMask::FiveTuple(), KeyMask::SrcIP(), KeyMask::DstIP(),
+                                      KeyMask::SrcDst(), KeyMask::SrcPrefix(24)};
+        uint32_t KEYS = masks.size();
+
+        std::vector<std::unordered_map<TUPLES, COUNT_TYPE>> realMp(KEYS);
+        for (uint64_t j = 0; j < length; ++j) {
+            for (uint32_t k = 0; k < KEYS; ++k)
+                realMp[k][masks[k].Apply(dataset[j])] += 1;
+        }
+
+        auto printKeys = [&](std::vector<std::unordered_map<TUPLES, COUNT_TYPE>>& estMp) {
+            for (uint32_t k = 0; k < KEYS; ++k) {
+                HHMetric metric = Evaluate(estMp[k], realMp[k], threshold);
+                std::cout << "    " << masks[k].name << ": F1 " << metric.f1score
+                          << ", ARE " << metric.are << std::endl;
+            }
+        };
+
+        TP start, end;
+        std::vector<std::unordered_map<TUPLES, COUNT_TYPE>> estMp(KEYS);
+
+        std::cout << "+------------------------------------------------+" << std::endl;
+        std::cout << "- " << KEYS << " x " << SketchType<TUPLES>(MEMORY).name << ", one pass per key" << std::endl;
+        double separate = 0;
+        for (uint32_t k = 0; k < KEYS; ++k) {
+            Abstract<TUPLES>* tupleSketch = Seeded(new SketchType<TUPLES>(MEMORY));
+            start = now();
+            for (uint64_t j = 0; j < length; ++j) {
+                tupleSketch->Insert(masks[k].Apply(dataset[j]));
+            }
+            end = now();
+            separate += durationms(end, start);
+            estMp[k] = tupleSketch->AllQuery();
+            delete tupleSketch;
+        }
+        std::cout << "    Insert (all keys): " << separate / length << " ms" << std::endl;
+        printKeys(estMp);
+
+        std::vector<MultiKey*> engines = {
+            new MultiKey(MEMORY * KEYS, masks, [this](uint32_t memory) -> Abstract<TUPLES>* {
+                return Seeded(new SketchType<TUPLES>(memory));
+            }, MultiKey::PER_KEY),
+            new MultiKey(MEMORY * KEYS, masks, [this](uint32_t memory) -> Abstract<TUPLES>* {
+                return Seeded(new CocoSketch<TUPLES>(memory));
+            }, MultiKey::SHARED)
+        };
+
+        for (auto engine : engines) {
+            std::cout << "- " << engine->name << ", one pass" << std::endl;
+            start = now();
+            for (uint64_t j = 0; j < length; ++j) {
+                engine->Insert(dataset[j]);
+            }
+            end = now();
+            std::cout << "    Insert (all keys): " << durationms(end, start) / length << " ms" << std::endl;
+
+            for (uint32_t k = 0; k < KEYS; ++k)
+                estMp[k] = engine->AllQuery(k);
+            printKeys(estMp);
+            delete engine;
+        }
+        std::cout << "+------------------------------------------------+" << std::endl;
+    }
+
+    /*
+     * srcIP hierarchical heavy hitters: accuracy and per-packet cost against the
+     * number of levels, after a check that one /32 bucket holding four flows of
+     * HEAVY packets each keeps them when a fifth flow arrives, which drives the
+     * decay of its slots far past the count where DECAY^count overflows 64 bits
+     */
+    bool HHHBench(uint32_t MEMORY, double alpha) {
+        constexpr COUNT_TYPE HEAVY = 5000;
+        HHH single(2 * sizeof(HHH::Bucket), 32);
+        single.Seed(seed);
+        TUPLES flows[HHH::COUNTER_PER_BUCKET + 1] = {};
+        for (uint32_t k = 0; k <= HHH::COUNTER_PER_BUCKET; ++k)
+            flows[k].data[3] = k + 1;
+        for (COUNT_TYPE j = 0; j < HEAVY; ++j) {
+            for (uint32_t k = 0; k < HHH::COUNTER_PER_BUCKET; ++k)
+                single.Insert(flows[k]);
+        }
+        for (COUNT_TYPE j = 0; j < HEAVY; ++j)
+            single.Insert(flows[HHH::COUNTER_PER_BUCKET]);
+        bool pass = true;
+        for (uint32_t k = 0; k < HHH::COUNTER_PER_BUCKET; ++k)
+            pass = pass && single.Query(0, flows[k].srcIP()) == HEAVY;
+
+        COUNT_TYPE threshold = alpha * length;
+        auto prefixKey = [](const HHH::Prefix& p) -> uint64_t {
+            return ((uint64_t)p.length << 32) | p.prefix;
+        };
+
+        std::cout << "+------------------------------------------------+" << std::endl;
+        std::cout << "- Full bucket, " << HEAVY << " packets per flow: " << (pass ? "PASS" : "FAIL") << std::endl;
+        std::cout << "- HHH over srcIP prefixes, threshold " << threshold << std::endl;
+
+        for (uint32_t granularity : {8, 4, 2, 1}) {
+            for (HHH::Mode mode : {HHH::ALL_LEVELS, HHH::SAMPLED}) {
+                HHH hhh(MEMORY, granularity, mode);
+                hhh.Seed(seed);
+
+                std::vector<HHH::HashMap> realMp(hhh.Levels());
+                for (uint64_t j = 0; j < length; ++j) {
+                    uint32_t ip = ntohl(dataset[j].srcIP());
+                    for (uint32_t i = 0; i < hhh.Levels(); ++i)
+                        realMp[i][ip & hhh.Mask(i)] += 1;
+                }
+                std::unordered_map<uint64_t, COUNT_TYPE> real;
+                for (auto& p : hhh.Extract(realMp, threshold))
+                    real[prefixKey(p)] = p.count;
+
+                TP start = now();
+                for (uint64_t j = 0; j < length; ++j) {
+                    hhh.Insert(dataset[j]);
+                }
+                TP end = now();
+
+                std::unordered_map<uint64_t, COUNT_TYPE> est;
+                for (auto& p : hhh.Output(threshold))
+                    est[prefixKey(p)] = p.count;
+
+                double both = 0, are = 0;
+                for (auto it = est.begin(); it != est.end(); ++it) {
+                    auto find = real.find(it->first);
+                    if (find != real.end()) {
+                        both += 1;
+                        are += std::abs((double)it->second - find->second) / find->second;
+                    }
+                }
+                double recall = real.empty() ? 1 : both / real.size();
+                double precision = est.empty() ? 1 : both / est.size();
+
+                std::cout << "- " << hhh.name << std::endl;
+                std::cout << "    Insert: " << (durationms(end, start) / length) << " ms" << std::endl;
+                std::cout << "    HHH: " << real.size() << " real, " << est.size() << " reported" << std::endl;
+                std::cout << "    Recall: " << recall << ", Precision: " << precision
+                          << ", ARE: " << (both > 0 ? are / both : 0) << std::endl;
+            }
+        }
+        std::cout << "+------------------------------------------------+" << std::endl;
+        return pass;
+    }
+
+    /* Flows whose count changed by more than alpha * EPOCH_LENGTH between consecutive epochs */
+    void HeavyChangeBench(uint32_t MEMORY, double alpha, uint64_t EPOCH_LENGTH) {
+        COUNT_TYPE threshold = alpha * EPOCH_LENGTH;
+        uint64_t EPOCHS = length / EPOCH_LENGTH;
+        if (EPOCHS < 2) {
+            std::cout << "Heavy-change bench needs at least two epochs of " << EPOCH_LENGTH << " packets" << std::endl;
+            return;
+        }
+
+        std::vector<HeavyChanger<TUPLES>::Factory> factories = {
+            [this](uint32_t memory) -> Abstract<TUPLES>* { return Seeded(new MVSketch<TUPLES>(memory)); },
+            [this](uint32_t memory) -> Abstract<TUPLES>* { return Seeded(new SketchType<TUPLES>(memory)); }
+        };
+
+        for (auto& factory : factories) {
+            HeavyChanger<TUPLES> changer(MEMORY, factory);
+            std::unordered_map<TUPLES, COUNT_TYPE> previousMp, currentMp;
+            HHMetric sum;
+            double insertTime = 0;
+            uint64_t realChanges = 0, estChanges = 0;
+
+            for (uint64_t e = 0; e < EPOCHS; ++e) {
+                TP start = now();
+                for (uint64_t j = e * EPOCH_LENGTH; j < (e + 1) * EPOCH_LENGTH; ++j) {
+                    changer.Insert(dataset[j]);
+                }
+                TP end = now();
+                insertTime += durationms(end, start);
+
+                currentMp.clear();
+                for (uint64_t j = e * EPOCH_LENGTH; j < (e + 1) * EPOCH_LENGTH; ++j) {
+                    currentMp[dataset[j]] += 1;
+                }
+
+                if (e > 0) {
+                    std::unordered_map<TUPLES, COUNT_TYPE> realMp, estMp;
+                    for (auto it = currentMp.begin(); it != currentMp.end(); ++it) {
+                        auto find = previousMp.find(it->first);
+                        realMp[it->first] = it->second - ((find == previousMp.end()) ? 0 : find->second);
+                    }
+                    for (auto it = previousMp.begin(); it != previousMp.end(); ++it) {
+                        if (currentMp.find(it->first) == currentMp.end())
+                            realMp[it->first] = -it->second;
+                    }
+
+                    /* Evaluate compares magnitudes, so a change in the wrong direction counts as missed */
+                    estMp = changer.Changes(threshold);
+                    estChanges += estMp.size();
+                    for (auto it = estMp.begin(); it != estMp.end(); ++it) {
+                        auto find = realMp.find(it->first);
+                        bool opposite = (find != realMp.end()) && ((double)find->second * it->second < 0);
+                        it->second = opposite ? 0 : std::abs(it->second);
+                    }
+                    for (auto it = realMp.begin(); it != realMp.end(); ++it) {
+                        it->second = std::abs(it->second);
+                        realChanges += (it->second > threshold);
+                    }
+                    sum += Evaluate(estMp, realMp, threshold);
+                }
+
+                previousMp.swap(currentMp);
+                changer.Rotate();
+            }
+
+            double reported = EPOCHS - 1;
+            std::cout << "+------------------------------------------------+" << std::endl;
+            std::cout << "- " << changer.name << std::endl;
+            std::cout << "    Epochs: " << EPOCHS << " x " << EPOCH_LENGTH << " packets" << std::endl;
+            std::cout << "    Threshold: " << threshold << std::endl;
+            std::cout << "    Insert: " << insertTime / (EPOCHS * EPOCH_LENGTH) << " ms" << std::endl;
+            std::cout << "    Changers: " << realChanges << " real, " << estChanges << " reported" << std::endl;
+            std::cout << "    Recall: " << sum.recall / reported << std::endl;
+            std::cout << "    Precision: " << sum.precision / reported << std::endl;
+            std::cout << "    F1 Socre: " << sum.f1score / reported << std::endl;
+            std::cout << "    AAE: " << sum.aae / reported << std::endl;
+            std::cout << "    ARE: " << sum.are / reported << std::endl;
+        }
+        std::cout << "+------------------------------------------------+" << std::endl;
+    }
+
+    /* Heavy hitters by bytes: every sketch with unit and with weighted inserts */
+    void WeightedBench(uint32_t MEMORY, double alpha) {
+        if (weights.empty()) {
+            std::cout << "Weighted bench needs a trace of PACKET records (--format=weighted)" << std::endl;
+            return;
+        }
+
+        std::unordered_map<TUPLES, COUNT_TYPE> bytesMp;
+        uint64_t bytes = 0;
+        for (uint64_t j = 0; j < length; ++j) {
+            bytesMp[dataset[j]] += weights[j];
+            bytes += weights[j];
+        }
+        COUNT_TYPE threshold = alpha * bytes;
+
+        std::vector<std::function<Abstract<TUPLES>*()>> factories = Sketches(MEMORY, threshold);
+
+        std::cout << "+------------------------------------------------+" << std::endl;
+        std::cout << "- Total Bytes: " << bytes << ", Threshold: " << threshold << " bytes" << std::endl;
+
+        for (auto& factory : factories) {
+            Abstract<TUPLES>* unitSketch = Seeded(factory());
+            Abstract<TUPLES>* byteSketch = Seeded(factory());
+            TP start, end;
+
+            start = now();
+            for (uint64_t j = 0; j < length; ++j) {
+                unitSketch->Insert(dataset[j]);
+            }
+            end = now();
+            double unitTime = durationms(end, start) / length;
+
+            start = now();
+            for (uint64_t j = 0; j < length; ++j) {
+                byteSketch->Insert(dataset[j], weights[j]);
+            }
+            end = now();
+            double byteTime = durationms(end, start) / length;
+
+            std::unordered_map<TUPLES, COUNT_TYPE> estBytes = byteSketch->AllQuery();
+            HHMetric metric = Evaluate(estBytes, bytesMp, threshold);
+
+            std::cout << "- " << byteSketch->name << std::endl;
+            std::cout << "    Insert: " << unitTime << " ms (unit), " << byteTime << " ms (weighted)" << std::endl;
+            std::cout << "    Recall: " << metric.recall << ", Precision: " << metric.precision
+                      << ", F1 Socre: " << metric.f1score << ", ARE: " << metric.are << std::endl;
+
+            delete unitSketch;
+            delete byteSketch;
+        }
+        std::cout << "+------------------------------------------------+" << std::endl;
+    }
+
+    /*
+     * One shared table updated with relaxed atomics against one table per thread
+     * of MEMORY / threads each, merged by summing at query time. Each thread
+     * inserts a contiguous slice of the trace.
+     */
+    void ConcurrentBench(uint32_t MEMORY, double alpha, uint32_t MAX_THREADS) {
+        COUNT_TYPE threshold = alpha * length;
+
+        std::unordered_map<TUPLES, COUNT_TYPE> heavy;
+        for (auto it = tuplesMp.begin(); it != tuplesMp.end(); ++it) {
+            if (it->second > threshold)
+                heavy.insert(*it);
+        }
+
+        auto sketchARE = [&](std::function<COUNT_TYPE(const TUPLES&)> query) {
+            double are = 0;
+            for (auto it = heavy.begin(); it != heavy.end(); ++it)
+                are += std::abs(query(it->first) - it->second) / (double)it->second;
+            return heavy.empty() ? 0 : are / heavy.size();
+        };
+
+        std::cout << "+------------------------------------------------+" << std::endl;
+        std::cout << "- Concurrent Insert, " << std::thread::hardware_concurrency() << " hardware threads" << std::endl;
+
+        for (uint32_t threads = 1; threads <= MAX_THREADS; threads *= 2) {
+            std::cout << "- Threads: " << threads << std::endl;
+
+            SharedAndSharded<CMSketch<TUPLES, COUNT_TYPE>>("CMSketch", MEMORY, threads, sketchARE);
+            SharedAndSharded<CSketch<TUPLES, COUNT_TYPE>>("CSketch", MEMORY, threads, sketchARE);
+            SharedAndSharded<CountingBloomFilter<TUPLES, COUNT_TYPE>>("CountingBloomFilter", MEMORY, threads, sketchARE);
+
+            {
+                SharedCocoSketch<TUPLES> shared(MEMORY);
+                shared.Seed(seed);
+                double time = Parallel(threads, [&](uint32_t t, uint64_t begin, uint64_t end) {
+                    SharedCocoSketch<TUPLES>::Writer(t);
+                    for (uint64_t j = begin; j < end; ++j)
+                        shared.Insert(dataset[j]);
+                });
+                std::unordered_map<TUPLES, COUNT_TYPE> est = shared.AllQuery();
+                HHMetric metric = Evaluate(est, tuplesMp, threshold);
+                std::cout << "    CocoSketch shared:            " << length / time << " Mpps, F1 Socre: " << metric.f1score
+                          << ", ARE: " << metric.are << std::endl;
+            }
+
+            {
+                std::vector<CocoSketch<TUPLES>*> shards;
+                for (uint32_t t = 0; t < threads; ++t)
+                    shards.push_back(Seeded(new CocoSketch<TUPLES>(MEMORY / threads)));
+                double time = Parallel(threads, [&](uint32_t t, uint64_t begin, uint64_t end) {
+                    for (uint64_t j = begin; j < end; ++j)
+                        shards[t]->Insert(dataset[j]);
+                });
+                std::unordered_map<TUPLES, COUNT_TYPE> est;
+                for (auto shard : shards) {
+                    std::unordered_map<TUPLES, COUNT_TYPE> part = shard->AllQuery();
+                    for (auto it = part.begin(); it != part.end(); ++it)
+                        est[it->first] += it->second;
+                    delete shard;
+                }
+                HHMetric metric = Evaluate(est, tuplesMp, threshold);
+                std::cout << "    CocoSketch sharded:           " << length / time << " Mpps, F1 Socre: " << metric.f1score
+                          << ", ARE: " << metric.are << std::endl;
+            }
+        }
+        std::cout << "+------------------------------------------------+" << std::endl;
+    }
+
+    /* Each sketch fed directly and through an Aggregator; then a shared table with one buffer per thread */
+    void AggregateBench(uint32_t MEMORY, double alpha, uint32_t SETS, uint64_t FLUSH_INTERVAL, uint32_t THREADS) {
+        COUNT_TYPE threshold = alpha * length;
+
+        std::vector<std::function<Abstract<TUPLES>*()>> factories = {
+            [&]() -> Abstract<TUPLES>* { return new CocoSketch<TUPLES>(MEMORY); },
+            [&]() -> Abstract<TUPLES>* { return new Elastic<TUPLES>(MEMORY); },
+            [&]() -> Abstract<TUPLES>* { return new CMHeap<TUPLES>(MEMORY); },
+            [&]() -> Abstract<TUPLES>* { return new CountHeap<TUPLES>(MEMORY); },
+            [&]() -> Abstract<TUPLES>* { return new SpaceSaving<TUPLES>(MEMORY); },
+            [&]() -> Abstract<TUPLES>* { return new MVSketch<TUPLES>(MEMORY); },
+            [&]() -> Abstract<TUPLES>* { return new SketchType<TUPLES>(MEMORY); }
+        };
+
+        std::cout << "+------------------------------------------------+" << std::endl;
+        std::cout << "- Buffer: " << SETS << " x " << Aggregator<TUPLES>::WAYS << " entries, flush every "
+                  << FLUSH_INTERVAL << " packets" << std::endl;
+
+        for (auto& factory : factories) {
+            Abstract<TUPLES>* direct = Seeded(factory());
+            Abstract<TUPLES>* buffered = Seeded(factory());
+            Aggregator<TUPLES> buffer(buffered, SETS, FLUSH_INTERVAL);
+            TP start, end;
+
+            start = now();
+            for (uint64_t j = 0; j < length; ++j) {
+                direct->Insert(dataset[j]);
+            }
+            end = now();
+            double directTime = durationms(end, start) / length;
+
+            start = now();
+            for (uint64_t j = 0; j < length; ++j) {
+                buffer.Insert(dataset[j]);
+            }
+            buffer.Flush();
+            end = now();
+            double bufferedTime = durationms(end, start) / length;
+
+            std::unordered_map<TUPLES, COUNT_TYPE> estDirect = direct->AllQuery();
+            std::unordered_map<TUPLES, COUNT_TYPE> estBuffered = buffered->AllQuery();
+            HHMetric metricDirect = Evaluate(estDirect, tuplesMp, threshold);
+            HHMetric metricBuffered = Evaluate(estBuffered, tuplesMp, threshold);
+
+            std::cout << "- " << direct->name << std::endl;
+            std::cout << "    Insert: " << directTime << " ms (direct), " << bufferedTime << " ms (buffered), speedup "
+                      << directTime / bufferedTime << "x" << std::endl;
+            std::cout << "    Hit Ratio: " << buffer.HitRatio() << ", Sketch Updates: " << buffer.UpdateRatio() << " per packet" << std::endl;
+            std::cout << "    F1 Socre: " << metricDirect.f1score << " (direct), " << metricBuffered.f1score
+                      << " (buffered), ARE: " << metricDirect.are << " (direct), " << metricBuffered.are << " (buffered)" << std::endl;
+
+            delete direct;
+            delete buffered;
+        }
+
+        for (uint32_t threads = 1; threads <= THREADS; threads *= 2) {
+            SharedCocoSketch<TUPLES> direct(MEMORY), buffered(MEMORY);
+            direct.Seed(seed);
+            buffered.Seed(seed);
+
+            double directTime = Parallel(threads, [&](uint32_t t, uint64_t begin, uint64_t end) {
+                SharedCocoSketch<TUPLES>::Writer(t);
+                for (uint64_t j = begin; j < end; ++j)
+                    direct.Insert(dataset[j]);
+            });
+            double bufferedTime = Parallel(threads, [&](uint32_t t, uint64_t begin, uint64_t end) {
+                SharedCocoSketch<TUPLES>::Writer(t);
+                Aggregator<TUPLES> buffer(&buffered, SETS, FLUSH_INTERVAL);
+                for (uint64_t j = begin; j < end; ++j)
+                    buffer.Insert(dataset[j]);
+                buffer.Flush();
+            });
+
+            std::unordered_map<TUPLES, COUNT_TYPE> est = buffered.AllQuery();
+            HHMetric metric = Evaluate(est, tuplesMp, threshold);
+            std::cout << "- SharedCocoSketch, " << threads << " threads" << std::endl;
+            std::cout << "    " << length / directTime << " Mpps (direct), " << length / bufferedTime
+                      << " Mpps (buffered), F1 Socre: " << metric.f1score << " (buffered)" << std::endl;
+        }
+        std::cout << "+------------------------------------------------+" << std::endl;
+    }
+
+    /*
+     * Every sketch with the seeds seed, seed + 1, ..., seed + REPEAT - 1, spread
+     * over the hardware threads; mean and 95% confidence interval across seeds.
+     * Concurrent runs share caches and memory bandwidth, so compare throughput
+     * between sketches rather than with single-run numbers.
+     */
+    void RepeatBench(uint32_t MEMORY, double alpha, uint32_t REPEAT) {
+        COUNT_TYPE threshold = alpha * length;
+        uint32_t workers = std::max(1u, std::min(REPEAT, std::thread::hardware_concurrency()));
+
+        std::cout << "+------------------------------------------------+" << std::endl;
+        std::cout << "- Seeds " << seed << " to " << seed + REPEAT - 1 << ", " << workers << " at a time" << std::endl;
+
+        for (auto& factory : Sketches(MEMORY, threshold)) {
+            std::vector<double> mpps(REPEAT), f1(REPEAT);
+            std::string name;
+
+            Pool(workers, REPEAT, [&](uint64_t r) {
+                Abstract<TUPLES>* sketch = factory();
+                sketch->Seed(seed + r);
+
+                TP start = now();
+                for (uint64_t j = 0; j < length; ++j) {
+                    sketch->Insert(dataset[j]);
+                }
+                mpps[r] = length / durationms(now(), start);
+
+                std::unordered_map<TUPLES, COUNT_TYPE> estTuple = sketch->AllQuery();
+                f1[r] = Evaluate(estTuple, tuplesMp, threshold).f1score;
+                if (r == 0)
+                    name = sketch->name;
+                delete sketch;
+            });
+
+            std::pair<double, double> throughput = Interval(mpps), score = Interval(f1);
+            std::cout << "- " << name << std::endl;
+            std::cout << "    Insert: " << throughput.first << " +- " << throughput.second << " Mpps" << std::endl;
+            std::cout << "    F1 Socre: " << score.first << " +- " << score.second << std::endl;
+        }
+        std::cout << "+------------------------------------------------+" << std::endl;
+    }
+
+    /*
+     * Grid of sketches x memories x thresholds x seeds from one load of the trace.
+     * Accuracy runs share the worker pool; one run of a sketch answers every
+     * threshold unless the sketch is built for its threshold (TwoStage). Timed
+     * runs, one per sketch and memory, come afterwards one at a time, so they
+     * have a core and the caches to themselves. Prints one CSV row per
+     * configuration; f1_ci95 is the half-width across seeds.
+     */
+    void SweepBench(const std::vector<uint32_t>& MEMORIES, const std::vector<double>& ALPHAS,
+                    std::vector<std::string> NAMES, uint32_t SEEDS, uint32_t WORKERS, bool THROUGHPUT) {
+        if (NAMES.empty()) {
+            for (auto& entry : SketchRegistry<TUPLES>())
+                NAMES.push_back(entry.name);
+        }
+        std::vector<const SketchEntry<TUPLES>*> entries;
+        for (auto& name : NAMES)
+            entries.push_back(&FindSketch<TUPLES>(name));
+
+        struct Job{
+            uint32_t sketch, memory, seed;
+            std::vector<uint32_t> alphas;
+        };
+        std::vector<Job> accuracyJobs, timedJobs;
+        for (uint32_t n = 0; n < entries.size(); ++n) {
+            for (uint32_t m = 0; m < MEMORIES.size(); ++m) {
+                if (THROUGHPUT)
+                    timedJobs.push_back({n, m, 0, {0}});
+                for (uint32_t r = 0; r < SEEDS; ++r) {
+                    if (entries[n]->thresholded) {
+                        for (uint32_t a = 0; a < ALPHAS.size(); ++a)
+                            accuracyJobs.push_back({n, m, r, {a}});
+                    }
+                    else {
+                        std::vector<uint32_t> all(ALPHAS.size());
+                        for (uint32_t a = 0; a < ALPHAS.size(); ++a)
+                            all[a] = a;
+                        accuracyJobs.push_back({n, m, r, all});
+                    }
+                }
+            }
+        }
+
+        auto build = [&](const Job& job) {
+            Abstract<TUPLES>* sketch = entries[job.sketch]->factory(MEMORIES[job.memory], ALPHAS[job.alphas[0]] * length);
+            sketch->Seed(seed + job.seed);
+            return sketch;
+        };
+        auto index = [&](uint32_t n, uint32_t m, uint32_t a) {
+            return (n * MEMORIES.size() + m) * ALPHAS.size() + a;
+        };
+
+        std::vector<std::vector<HHMetric>> metrics(entries.size() * MEMORIES.size() * ALPHAS.size(), std::vector<HHMetric>(SEEDS));
+        std::vector<double> insertTime(entries.size() * MEMORIES.size(), 0), queryTime(entries.size() * MEMORIES.size(), 0);
+
+        double accuracyWall = Pool(WORKERS, accuracyJobs.size(), [&](uint64_t i) {
+            const Job& job = accuracyJobs[i];
+            Abstract<TUPLES>* sketch = build(job);
+            for (uint64_t j = 0; j < length; ++j) {
+                sketch->Insert(dataset[j]);
+            }
+            std::unordered_map<TUPLES, COUNT_TYPE> estTuple = sketch->AllQuery();
+            for (uint32_t a : job.alphas)
+                metrics[index(job.sketch, job.memory, a)][job.seed] = Evaluate(estTuple, tuplesMp, (COUNT_TYPE)(ALPHAS[a] * length));
+            delete sketch;
+        });
+
+        double timedWall = Pool(1, timedJobs.size(), [&](uint64_t i) {
+            const Job& job = timedJobs[i];
+            Abstract<TUPLES>* sketch = build(job);
+            TP start = now();
+            for (uint64_t j = 0; j < length; ++j) {
+                sketch->Insert(dataset[j]);
+            }
+            TP middle = now();
+            for (uint64_t j = 0; j < length; ++j) {
+                sketch->Query(dataset[j]);
+            }
+            TP end = now();
+            insertTime[job.sketch * MEMORIES.size() + job.memory] = durationms(middle, start) / length;
+            queryTime[job.sketch * MEMORIES.size() + job.memory] = durationms(end, middle) / length;
+            delete sketch;
+        });
+
+        std::cout << "+------------------------------------------------+" << std::endl;
+        std::cout << "- Sweep: " << entries.size() << " sketches x " << MEMORIES.size() << " memories x "
+                  << ALPHAS.size() << " thresholds x " << SEEDS << " seeds" << std::endl;
+        std::cout << "    Accuracy: " << accuracyJobs.size() << " runs on " << WORKERS << " workers, "
+                  << accuracyWall / 1e6 << " s" << std::endl;
+        std::cout << "    Throughput: " << timedJobs.size() << " runs one at a time, " << timedWall / 1e6 << " s" << std::endl;
+        std::cout << "sketch,memory,threshold,insert_ms,query_ms,recall,precision,f1,f1_ci95,aae,are" << std::endl;
+        for (uint32_t n = 0; n < entries.size(); ++n) {
+            for (uint32_t m = 0; m < MEMORIES.size(); ++m) {
+                for (uint32_t a = 0; a < ALPHAS.size(); ++a) {
+                    std::vector<HHMetric>& runs = metrics[index(n, m, a)];
+                    HHMetric mean;
+                    std::vector<double> f1;
+                    for (auto& run : runs) {
+                        mean += run;
+                        f1.push_back(run.f1score);
+                    }
+                    std::cout << entries[n]->name << "," << MEMORIES[m] << "," << ALPHAS[a] << ","
+                              << insertTime[n * MEMORIES.size() + m] << "," << queryTime[n * MEMORIES.size() + m] << ","
+                              << mean.recall / SEEDS << "," << mean.precision / SEEDS << "," << mean.f1score / SEEDS << ","
+                              << Interval(f1).second << "," << mean.aae / SEEDS << "," << mean.are / SEEDS << std::endl;
+                }
+            }
+        }
+        std::cout << "+------------------------------------------------+" << std::endl;
+    }
+
+    /*
+     * Smallest memory at which sketch NAME reaches F1 >= TARGET_F1 and
+     * ARE <= TARGET_ARE on the first SAMPLE packets, over every setting of its
+     * knobs (Src/Registry.h). Each setting bisects the memory on a log scale
+     * between MIN_MEMORY and MAX_MEMORY down to TOLERANCE; once some setting
+     * has met the target, a setting that fails just below that memory is
+     * dropped after one run. The settings that meet the target at the final
+     * memory are timed and the fastest is chosen.
+     */
+    void TuneBench(const std::string& NAME, double alpha, uint64_t SAMPLE, double TARGET_F1, double TARGET_ARE,
+                   uint32_t MIN_MEMORY, uint32_t MAX_MEMORY, double TOLERANCE) {
+        if (MIN_MEMORY == 0 || MIN_MEMORY > MAX_MEMORY || TOLERANCE <= 0)
+            throw std::invalid_argument("Tuning needs 0 < min memory <= max memory and a positive tolerance");
+
+        TunableEntry<TUPLES> entry = FindTunable<TUPLES>(NAME);
+        SAMPLE = std::min(SAMPLE, length);
+        COUNT_TYPE threshold = alpha * SAMPLE;
+
+        std::unordered_map<TUPLES, COUNT_TYPE> sampleMp;
+        for (uint64_t j = 0; j < SAMPLE; ++j) {
+            sampleMp[dataset[j]] += 1;
+        }
+
+        std::vector<std::vector<double>> settings(1);
+        for (auto& knob : entry.knobs) {
+            std::vector<std::vector<double>> product;
+            for (auto& setting : settings) {
+                for (double value : knob.values) {
+                    product.push_back(setting);
+                    product.back().push_back(value);
+                }
+            }
+            settings.swap(product);
+        }
+        auto label = [&](uint32_t s) {
+            std::string ret;
+            for (uint32_t k = 0; k < entry.knobs.size(); ++k) {
+                std::ostringstream value;
+                value << settings[s][k];
+                ret += (k ? ", " : "") + entry.knobs[k].name + "=" + value.str();
+            }
+            return ret.empty() ? std::string("default") : ret;
+        };
+
+        std::map<std::pair<uint32_t, uint32_t>, HHMetric> runs;
+        auto evaluate = [&](uint32_t s, uint32_t memory) -> const HHMetric& {
+            auto it = runs.find(std::make_pair(s, memory));
+            if (it == runs.end()) {
+                Abstract<TUPLES>* sketch = Seeded(entry.factory(memory, threshold, settings[s]));
+                for (uint64_t j = 0; j < SAMPLE; ++j) {
+                    sketch->Insert(dataset[j]);
+                }
+                std::unordered_map<TUPLES, COUNT_TYPE> estTuple = sketch->AllQuery();
+                delete sketch;
+                it = runs.emplace(std::make_pair(s, memory), Evaluate(estTuple, sampleMp, threshold)).first;
+            }
+            return it->second;
+        };
+        auto meets = [&](uint32_t s, uint32_t memory) {
+            const HHMetric& metric = evaluate(s, memory);
+            return metric.f1score >= TARGET_F1 && metric.are <= TARGET_ARE;
+        };
+
+        std::cout << "+------------------------------------------------+" << std::endl;
+        std::cout << "- Tune " << NAME << ": F1 >= " << TARGET_F1 << ", ARE <= " << TARGET_ARE
+                  << " on " << SAMPLE << " packets, threshold " << threshold << std::endl;
+
+        uint32_t best = 0;
+        for (uint32_t s = 0; s < settings.size(); ++s) {
+            uint32_t hi = best ? best / (1 + TOLERANCE) : MAX_MEMORY;
+            if (hi < MIN_MEMORY || !meets(s, hi)) {
+                std::cout << "    " << label(s) << ": fails at " << hi << " bytes" << std::endl;
+                continue;
+            }
+            uint32_t lo = MIN_MEMORY;
+            if (meets(s, lo)) {
+                hi = lo;
+            }
+            while (hi > lo * (1 + TOLERANCE)) {
+                uint32_t mid = std::sqrt((double)lo * hi);
+                if (meets(s, mid))
+                    hi = mid;
+                else
+                    lo = mid;
+            }
+            best = hi;
+            std::cout << "    " << label(s) << ": " << best << " bytes" << std::endl;
+        }
+        std::cout << "    Runs: " << runs.size() << std::endl;
+
+        if (best == 0) {
+            std::cout << "- Target not reached within " << MAX_MEMORY << " bytes" << std::endl;
+            std::cout << "+------------------------------------------------+" << std::endl;
+            return;
+        }
+
+        int32_t chosen = -1;
+        double fastest = 0;
+        for (uint32_t s = 0; s < settings.size(); ++s) {
+            if (!meets(s, best))
+                continue;
+            Abstract<TUPLES>* sketch = Seeded(entry.factory(best, threshold, settings[s]));
+            TP start = now();
+            for (uint64_t j = 0; j < SAMPLE; ++j) {
+                sketch->Insert(dataset[j]);
+            }
+            TP end = now();
+            delete sketch;
+
+            double mpps = SAMPLE / durationms(end, start);
+            if (mpps > fastest) {
+                fastest = mpps;
+                chosen = s;
+            }
+        }
+
+        const HHMetric& metric = evaluate(chosen, best);
+        std::cout << "- Chosen: " << label(chosen) << ", " << best << " bytes" << std::endl;
+        std::cout << "    Insert: " << fastest << " Mpps" << std::endl;
+        std::cout << "    F1 Socre: " << metric.f1score << std::endl;
+        std::cout << "    ARE: " << metric.are << std::endl;
+        std::cout << "+------------------------------------------------+" << std::endl;
+    }
+
+    /*
+     * Same memory, narrower light-part counters: more slots per byte. Lists the
+     * escalated slots of each narrow sketch that had to share a side counter.
+     */
+    void CounterBench(uint32_t MEMORY, double alpha) {
+        COUNT_TYPE threshold = alpha * length;
+
+        auto cm16 = new CMHeap<TUPLES, uint16_t>(MEMORY, "CMHeap (16-bit)");
+        auto cm8 = new CMHeap<TUPLES, uint8_t>(MEMORY, "CMHeap (8-bit)");
+        auto count16 = new CountHeap<TUPLES, int16_t>(MEMORY, "CountHeap (16-bit)");
+        auto count8 = new CountHeap<TUPLES, int8_t>(MEMORY, "CountHeap (8-bit)");
+
+        std::vector<Abstract<TUPLES>*> sketches = {
+            new CMHeap<TUPLES>(MEMORY, "CMHeap (32-bit)"), cm16, cm8,
+            new CountHeap<TUPLES>(MEMORY, "CountHeap (32-bit)"), count16, count8,
+            new Elastic<TUPLES>(MEMORY, 0, "Elastic (32-bit)"),
+            new Elastic<TUPLES, uint16_t>(MEMORY, 0, "Elastic (16-bit)"),
+            new Elastic<TUPLES, uint8_t>(MEMORY, 0, "Elastic (8-bit)")
+        };
+
+        for (auto sketch : sketches)
+            RunHH(Seeded(sketch), threshold, alpha);
+
+        std::cout << "- Escalated slots sharing a side counter" << std::endl;
+        std::cout << "    " << cm16->name << ": " << cm16->Shared() << std::endl;
+        std::cout << "    " << cm8->name << ": " << cm8->Shared() << std::endl;
+        std::cout << "    " << count16->name << ": " << count16->Shared() << std::endl;
+        std::cout << "    " << count8->name << ": " << count8->Shared() << std::endl;
+        std::cout << "+------------------------------------------------+" << std::endl;
+
+        for (auto sketch : sketches)
+            delete sketch;
+    }
+
+    /*
+     * Heap allocations per Insert and per Query, counted by the global
+     * operator new of Allocation.h over the whole trace. Both paths must stay
+     * off the heap; returns false if any sketch allocates.
+     */
+    bool AllocationBench(uint32_t MEMORY, double alpha) {
+        COUNT_TYPE threshold = alpha * length;
+        auto factory = [this](uint32_t memory) -> Abstract<TUPLES>* {
+            return Seeded(new SketchType<TUPLES>(memory));
+        };
+
+        std::vector<Abstract<TUPLES>*> sketches;
+        for (auto& entry : SketchRegistry<TUPLES>())
+            sketches.push_back(Seeded(entry.factory(MEMORY, threshold)));
+        sketches.push_back(Seeded(new CMHeap<TUPLES, uint8_t>(MEMORY, "CMHeap (8-bit)")));
+        sketches.push_back(Seeded(new CountHeap<TUPLES, int8_t>(MEMORY, "CountHeap (8-bit)")));
+        sketches.push_back(Seeded(new SharedCocoSketch<TUPLES>(MEMORY)));
+        sketches.push_back(new SlidingWindow<TUPLES>(MEMORY, length / 4, 8, factory));
+
+        uint32_t failed = 0;
+        std::cout << "+------------------------------------------------+" << std::endl;
+        std::cout << "- Allocations Per Operation" << std::endl;
+        for (auto sketch : sketches) {
+            uint64_t before = AllocationCount();
+            for (uint64_t j = 0; j < length; ++j) {
+                sketch->Insert(dataset[j]);
+            }
+            uint64_t inserts = AllocationCount() - before;
+
+            before = AllocationCount();
+            for (uint64_t j = 0; j < length; ++j) {
+                sketch->Query(dataset[j]);
+            }
+            uint64_t queries = AllocationCount() - before;
+
+            failed += (inserts != 0 || queries != 0);
+            std::cout << "    " << sketch->name << ": Insert " << (double)inserts / length
+                      << ", Query " << (double)queries / length << std::endl;
+            delete sketch;
+        }
+        std::cout << "- " << (failed ? "FAIL: " + std::to_string(failed) + " sketches allocate" : std::string("PASS")) << std::endl;
+        std::cout << "+------------------------------------------------+" << std::endl;
+        return failed == 0;
+    }
+
+    /*
+     * The all-zero key (0.0.0.0 as a srcIP, the /0 prefix) is a real flow:
+     * every registered sketch counts ZERO_PACKETS of it among the trace
+     * packets, as a 5-tuple and as a srcIP, and AllQuery must report it with
+     * an error below 10%. Fails if any sketch loses it.
+     */
+    bool ZeroKeyBench(uint32_t MEMORY) {
+        const uint64_t PACKETS = std::min<uint64_t>(length, 100000), ZERO_PACKETS = 1000;
+        uint32_t failed = 0;
+
+        std::cout << "+------------------------------------------------+" << std::endl;
+        std::cout << "- Zero key, " << ZERO_PACKETS << " of " << PACKETS + ZERO_PACKETS << " packets" << std::endl;
+        failed += ZeroKeyFailures<TUPLES>(MEMORY, PACKETS, ZERO_PACKETS, "5-tuple", [](const TUPLES& t) { return t; });
+        failed += ZeroKeyFailures<SRC_IP>(MEMORY, PACKETS, ZERO_PACKETS, "srcIP", [](const TUPLES& t) { return (SRC_IP)t.srcIP(); });
+        std::cout << "- " << (failed ? "FAIL: " + std::to_string(failed) + " sketches lose the zero key" : std::string("PASS")) << std::endl;
+        std::cout << "+------------------------------------------------+" << std::endl;
+        return failed == 0;
+    }
+
+    /* Entropy, F2 and distinct flows from the UnivMon heaps against the exact counts */
+    void GSumBench(uint32_t MEMORY) {
+        double exactF2 = 0, exactEntropy = 0;
+        for (auto& flow : tuplesMp) {
+            double f = flow.second;
+            exactF2 += f * f;
+            exactEntropy -= f / length * std::log2(f / length);
+        }
+        double exactDistinct = tuplesMp.size();
+
+        UnivMon<TUPLES>* sketch = Seeded(new UnivMon<TUPLES>(MEMORY, "UnivMon", 0, tuplesMp.size()));
+
+        std::cout << "+------------------------------------------------+" << std::endl;
+        std::cout << "- " << sketch->name << ", " << sketch->Levels() << " levels for " << tuplesMp.size() << " flows" << std::endl;
+
+        TP start = now();
+        for (uint64_t j = 0; j < length; ++j) {
+            sketch->Insert(dataset[j]);
+        }
+        TP end = now();
+        std::cout << "    Insert: " << durationms(end, start) / length << " ms" << std::endl;
+
+        start = now();
+        double entropy = sketch->Entropy(), f2 = sketch->F2(), distinct = sketch->Distinct();
+        end = now();
+        std::cout << "    G-sum queries: " << durationms(end, start) / 3 << " ms" << std::endl;
+
+        std::cout << "    Entropy: " << entropy << " (exact " << exactEntropy << ", RE "
+                  << std::abs(entropy - exactEntropy) / exactEntropy << ")" << std::endl;
+        std::cout << "    F2: " << f2 << " (exact " << exactF2 << ", RE "
+                  << std::abs(f2 - exactF2) / exactF2 << ")" << std::endl;
+        std::cout << "    Distinct: " << distinct << " (exact " << exactDistinct << ", RE "
+                  << std::abs(distinct - exactDistinct) / exactDistinct << ")" << std::endl;
+        std::cout << "+------------------------------------------------+" << std::endl;
+
+        delete sketch;
+    }
+
+    /*
+     * Flow-size distribution and entropy from Elastic (Distribution in
+     * Src/Elastic.h) on 1, 2, 4 ... THREADS threads, against the exact values:
+     * WMRE of the distribution, relative errors of the entropy and flow count,
+     * EM rounds and time, next to the insert time of the whole trace.
+     */
+    void DistributionBench(uint32_t MEMORY, uint32_t THREADS, uint32_t ROUNDS, double TOLERANCE, double BUDGET) {
+        std::vector<double> exact;
+        for (auto& flow : tuplesMp) {
+            if ((uint64_t)flow.second >= exact.size())
+                exact.resize((uint64_t)flow.second + 1);
+            exact[flow.second] += 1;
+        }
+        double exactEntropy = MRAC::Entropy(exact), exactFlows = tuplesMp.size();
+
+        Elastic<TUPLES>* sketch = Seeded(new Elastic<TUPLES>(MEMORY));
+        TP start = now();
+        for (uint64_t j = 0; j < length; ++j) {
+            sketch->Insert(dataset[j]);
+        }
+        double insertTime = durationms(now(), start);
+
+        std::cout << "+------------------------------------------------+" << std::endl;
+        std::cout << "- " << sketch->name << ", inserting the trace took " << insertTime << " ms" << std::endl;
+        std::cout << "- Exact: " << exactFlows << " flows, entropy " << exactEntropy << std::endl;
+
+        auto run = [&](uint32_t threads, double tolerance, const std::string& label) {
+            MRAC solver(threads, ROUNDS, tolerance, BUDGET);
+            start = now();
+            std::vector<double> dist = sketch->Distribution(solver);
+            double time = durationms(now(), start);
+
+            double diff = 0, sum = 0, flows = 0;
+            for (uint64_t s = 1; s < std::max(dist.size(), exact.size()); ++s) {
+                double estimate = (s < dist.size()) ? dist[s] : 0, real = (s < exact.size()) ? exact[s] : 0;
+                diff += std::abs(estimate - real);
+                sum += (estimate + real) / 2;
+                flows += estimate;
+            }
+            double entropy = MRAC::Entropy(dist);
+
+            std::cout << "- " << label << std::endl;
+            std::cout << "    Estimate: " << time << " ms, " << solver.Rounds() << " rounds" << std::endl;
+            std::cout << "    WMRE: " << diff / sum << std::endl;
+            std::cout << "    Entropy: " << entropy << ", RE " << std::abs(entropy - exactEntropy) / exactEntropy << std::endl;
+            std::cout << "    Flows: " << flows << ", RE " << std::abs(flows - exactFlows) / exactFlows << std::endl;
+        };
+
+        for (uint32_t threads = 1; threads <= THREADS; threads *= 2)
+            run(threads, TOLERANCE, std::to_string(threads) + " thread(s)");
+        run(THREADS, 0, std::to_string(THREADS) + " thread(s), all " + std::to_string(ROUNDS) + " rounds");
+        std::cout << "+------------------------------------------------+" << std::endl;
+
+        delete sketch;
+    }
+
+    /*
+     * SketchType fed straight from the generator, PACKETS packets that are never
+     * held in memory: the rate of generation alone, then of generation and
+     * Insert together, and the heavy hitters against exact flow counts
+     */
+    static void StreamBench(const Generator& generator, uint64_t PACKETS, uint32_t THREADS, uint32_t MEMORY, double alpha, uint32_t seed) {
+        std::cout << "+------------------------------------------------+" << std::endl;
+        std::cout << "- Stream of " << PACKETS << " packets, " << THREADS << " generator threads" << std::endl;
+
+        TP start = now();
+        generator.Stream(PACKETS, THREADS, [](const TUPLES*, uint64_t) {});
+        double generateTime = durationms(now(), start);
+
+        Abstract<TUPLES>* tupleSketch = new SketchType<TUPLES>(MEMORY);
+        tupleSketch->Seed(seed);
+        std::unordered_map<TUPLES, COUNT_TYPE> realMp;
+        double insertTime = 0;
+        start = now();
+        generator.Stream(PACKETS, THREADS, [&](const TUPLES* packets, uint64_t count) {
+            TP begin = now();
+            for (uint64_t j = 0; j < count; ++j)
+                tupleSketch->Insert(packets[j]);
+            insertTime += durationms(now(), begin);
+            for (uint64_t j = 0; j < count; ++j)
+                realMp[packets[j]] += 1;
+        });
+        double streamTime = durationms(now(), start);
+
+        std::cout << "    Generate: " << PACKETS / generateTime << " Mpps" << std::endl;
+        std::cout << "    Generate + " << tupleSketch->name << " + exact counts: " << PACKETS / streamTime << " Mpps, Insert "
+                  << insertTime / PACKETS << " ms" << std::endl;
+        std::cout << "    Flows: " << realMp.size() << std::endl;
+
+        std::unordered_map<TUPLES, COUNT_TYPE> estMp = tupleSketch->AllQuery();
+        COUNT_TYPE threshold = alpha * PACKETS;
+        PrintHH(Evaluate(estMp, realMp, threshold), PACKETS, threshold, alpha);
+        std::cout << "+------------------------------------------------+" << std::endl;
+        delete tupleSketch;
+    }
+
+    /*
+     * Every kernel variant of Dispatch.h this CPU supports against the scalar
+     * code: BOBHash32 of the trace keys, in order and through an index, and
+     * the byte-wise maximum of HyperLogLog merges. Fails on any difference.
+     */
+    bool DispatchBench() {
+        const uint32_t ROWS = 4, ROUNDS = 100;
+        std::vector<uint32_t> expect(length * ROWS), index(length), hashed(length);
+        for (uint64_t j = 0; j < length; ++j) {
+            index[j] = length - 1 - j;
+            for (uint32_t i = 0; i < ROWS; ++i)
+                expect[i * length + j] = hash(dataset[j], i, seed);
+        }
+
+        Random random(seed);
+        std::vector<uint8_t> target(1 << 16), source(1 << 16), merged(1 << 16), expectMerged(1 << 16);
+        for (uint32_t i = 0; i < target.size(); ++i) {
+            target[i] = random() % 64;
+            source[i] = random() % 64;
+            expectMerged[i] = std::max(target[i], source[i]);
+        }
+
+        bool agree = true;
+        std::cout << "+------------------------------------------------+" << std::endl;
+        std::cout << "- Kernels in use: " << CpuKernels().name << std::endl;
+        for (auto& kernels : SupportedKernels()) {
+            bool same = true;
+            TP start = now();
+            for (uint32_t i = 0; i < ROWS; ++i) {
+                kernels.HashKeys((const uint8_t*)dataset, sizeof(TUPLES), nullptr, length, i, seed, hashed.data());
+                same = same && std::equal(hashed.begin(), hashed.end(), expect.begin() + i * length);
+            }
+            double hashTime = durationms(now(), start);
+            for (uint32_t i = 0; i < ROWS; ++i) {
+                kernels.HashKeys((const uint8_t*)dataset, sizeof(TUPLES), index.data(), length, i, seed, hashed.data());
+                for (uint64_t j = 0; j < length; ++j)
+                    same = same && (hashed[j] == expect[i * length + index[j]]);
+            }
+
+            merged = target;
+            start = now();
+            for (uint32_t r = 0; r < ROUNDS; ++r)
+                kernels.MaxBytes(merged.data(), source.data(), merged.size());
+            double mergeTime = durationms(now(), start);
+            same = same && (merged == expectMerged);
+
+            agree = agree && same;
+            std::cout << "    " << kernels.name << ": HashKeys " << length * ROWS / hashTime << " M/s, MaxBytes "
+                      << merged.size() * ROUNDS / mergeTime / 1000 << " GB/s" << (same ? "" : ", MISMATCH") << std::endl;
+        }
+        std::cout << "- " << (agree ? "PASS" : "FAIL") << std::endl;
+        std::cout << "+------------------------------------------------+" << std::endl;
+        return agree;
+    }
+
+    /*
+     * Point queries of every packet of the trace against each sketch in NAMES
+     * (all registered if empty) at each of MEMORIES, one Query at a time and
+     * through QueryBatch, after inserting the trace. Memories past the caches
+     * show what prefetching a group of keys buys; the two must agree.
+     */
+    bool QueryBatchBench(const std::vector<uint32_t>& MEMORIES, double alpha, std::vector<std::string> NAMES) {
+        if (NAMES.empty()) {
+            for (auto& entry : SketchRegistry<TUPLES>())
+                NAMES.push_back(entry.name);
+        }
+
+        std::vector<COUNT_TYPE> scalar(length), batch(length);
+        bool agree = true;
+
+        std::cout << "+------------------------------------------------+" << std::endl;
+        std::cout << "- Query vs QueryBatch (Mpps), " << length << " keys" << std::endl;
+        for (auto& name : NAMES) {
+            for (uint32_t memory : MEMORIES) {
+                Abstract<TUPLES>* sketch = Seeded(CreateSketch<TUPLES>(name, memory, length * alpha));
+                for (uint64_t j = 0; j < length; ++j) {
+                    sketch->Insert(dataset[j]);
+                }
+
+                TP start = now();
+                for (uint64_t j = 0; j < length; ++j) {
+                    scalar[j] = sketch->Query(dataset[j]);
+                }
+                double scalarTime = durationms(now(), start);
+
+                start = now();
+                sketch->QueryBatch(dataset, batch.data(), length);
+                double batchTime = durationms(now(), start);
+
+                bool same = (scalar == batch);
+                agree = agree && same;
+                std::cout << "    " << sketch->name << ", " << memory << " bytes: " << length / scalarTime << " -> "
+                          << length / batchTime << " (x" << scalarTime / batchTime << ")" << (same ? "" : ", MISMATCH") << std::endl;
+                delete sketch;
+            }
+        }
+        std::cout << "- " << (agree ? "PASS" : "FAIL") << std::endl;
+        std::cout << "+------------------------------------------------+" << std::endl;
+        return agree;
+    }
+
+    /*
+     * Super-spreaders: sources with at least FANOUT distinct (dstIP, dstPort),
+     * found by SuperSpreader in the same pass as CocoSketch, each with MEMORY
+     * bytes, against the exact fan-out. Reports recall, precision, the ARE of
+     * the fan-out of the spreaders found and the packet rates, on the dataset
+     * and then on a generated trace with planted spreaders: sources of
+     * 2 FANOUT flows each, nearly all of them past FANOUT, of which
+     * MIN_RECALL must be found.
+     */
+    bool SpreaderBench(uint32_t MEMORY, COUNT_TYPE FANOUT) {
+        constexpr uint64_t PACKETS = 1 << 21, FLOWS = 1 << 17;
+        constexpr double MIN_RECALL = 0.8;
+
+        std::cout << "+------------------------------------------------+" << std::endl;
+        std::cout << "- " << fileName << std::endl;
+        Spreaders(dataset, length, MEMORY, FANOUT, seed);
+
+        Generator generator(FLOWS, 1.0, 1, 0, 2 * (uint64_t)FANOUT, 0, seed);
+        std::vector<TUPLES> planted(PACKETS);
+        generator.Fill(planted.data(), PACKETS, std::max(1u, std::thread::hardware_concurrency()));
+        std::cout << "- Planted: " << PACKETS << " packets, " << FLOWS << " flows, " << 2 * FANOUT << " per source" << std::endl;
+        uint64_t spreaders = 0;
+        double recall = Spreaders(planted.data(), PACKETS, MEMORY, FANOUT, seed, &spreaders);
+
+        bool pass = spreaders > 0 && recall >= MIN_RECALL;
+        std::cout << "- " << (pass ? "PASS" : "FAIL: the planted spreaders need recall " + std::to_string(MIN_RECALL)) << std::endl;
+        std::cout << "+------------------------------------------------+" << std::endl;
+        return pass;
+    }
+
+    /* One SpreaderBench run over count packets; returns the recall, and the number of real spreaders in spreaders */
+    static double Spreaders(const TUPLES* packets, uint64_t count, uint32_t MEMORY, COUNT_TYPE FANOUT, uint32_t seed,
+                            uint64_t* spreaders = nullptr) {
+        std::unordered_map<SRC_IP, std::unordered_set<uint64_t>> destinations;
+        for (uint64_t j = 0; j < count; ++j) {
+            destinations[packets[j].srcIP()].insert(((uint64_t)packets[j].dstIP() << 16) | packets[j].dstPort());
+        }
+        std::unordered_map<SRC_IP, COUNT_TYPE> real;
+        for (auto& source : destinations) {
+            if ((COUNT_TYPE)source.second.size() >= FANOUT)
+                real[source.first] = source.second.size();
+        }
+
+        CocoSketch<TUPLES>* alone = new CocoSketch<TUPLES>(MEMORY);
+        alone->Seed(seed);
+        TP start = now();
+        for (uint64_t j = 0; j < count; ++j) {
+            alone->Insert(packets[j]);
+        }
+        double aloneTime = durationms(now(), start);
+        delete alone;
+
+        CocoSketch<TUPLES>* sketch = new CocoSketch<TUPLES>(MEMORY);
+        sketch->Seed(seed);
+        SuperSpreader* spreader = new SuperSpreader(MEMORY);
+        spreader->Seed(seed);
+        start = now();
+        for (uint64_t j = 0; j < count; ++j) {
+            sketch->Insert(packets[j]);
+            spreader->Insert(packets[j]);
+        }
+        double bothTime = durationms(now(), start);
+
+        std::unordered_map<SRC_IP, COUNT_TYPE> est = spreader->AllQuery();
+        double correct = 0, reported = 0, are = 0;
+        for (auto& source : est) {
+            if (source.second < FANOUT)
+                continue;
+            reported += 1;
+            auto find = real.find(source.first);
+            if (find != real.end()) {
+                correct += 1;
+                are += std::abs(source.second - find->second) / (double)find->second;
+            }
+        }
+        double recall = real.empty() ? 1 : correct / real.size();
+
+        std::cout << "    " << spreader->name << ", fan-out " << FANOUT << ": " << real.size() << " of "
+                  << destinations.size() << " sources" << std::endl;
+        std::cout << "    Recall: " << recall << ", Precision: "
+                  << (reported == 0 ? 1 : correct / reported) << ", ARE: " << (correct == 0 ? 0 : are / correct) << std::endl;
+        std::cout << "    " << sketch->name << ": " << count / aloneTime << " Mpps, with " << spreader->name
+                  << ": " << count / bothTime << " Mpps" << std::endl;
+
+        delete sketch;
+        delete spreader;
+        if (spreaders)
+            *spreaders = real.size();
+        return recall;
+    }
+
+    /*
+     * Distinct flows from a HyperLogLog of DISTINCT_MEMORY registers carried by
+     * heavy-hitter sketches: the estimate against the exact count and the time
+     * it adds per packet, then the union of per-part estimators.
+     */
+    void CardinalityBench(uint32_t MEMORY, uint32_t DISTINCT_MEMORY, uint32_t PARTS) {
+        double exact = tuplesMp.size();
+
+        struct Carried{
+            Abstract<TUPLES>* plain;
+            Abstract<TUPLES>* carried;
+            std::function<double()> distinct;
+        };
+        Cardinality<TUPLES>* coco = new Cardinality<TUPLES>(new CocoSketch<TUPLES>(MEMORY), DISTINCT_MEMORY);
+        Cardinality<TUPLES>* elastic = new Cardinality<TUPLES>(new Elastic<TUPLES>(MEMORY), DISTINCT_MEMORY);
+        Cardinality<TUPLES>* tight = new Cardinality<TUPLES>(new TightSketch<TUPLES>(MEMORY), DISTINCT_MEMORY);
+        UnivMon<TUPLES>* univmon = new UnivMon<TUPLES>(MEMORY, "UnivMon + HyperLogLog (shared hash)", DISTINCT_MEMORY);
+        std::vector<Carried> runs = {
+            {new CocoSketch<TUPLES>(MEMORY), coco, [=]() { return coco->Distinct(); }},
+            {new Elastic<TUPLES>(MEMORY), elastic, [=]() { return elastic->Distinct(); }},
+            {new TightSketch<TUPLES>(MEMORY), tight, [=]() { return tight->Distinct(); }},
+            {new UnivMon<TUPLES>(MEMORY), univmon, [=]() { return univmon->Distinct(); }}
+        };
+
+        std::cout << "+------------------------------------------------+" << std::endl;
+        std::cout << "- Distinct flows: " << exact << ", HyperLogLog of " << HyperLogLog(DISTINCT_MEMORY).Memory() << " registers" << std::endl;
+        for (auto& run : runs) {
+            double time[2];
+            Abstract<TUPLES>* sketches[2] = {Seeded(run.plain), Seeded(run.carried)};
+            for (uint32_t k = 0; k < 2; ++k) {
+                TP start = now();
+                for (uint64_t j = 0; j < length; ++j) {
+                    sketches[k]->Insert(dataset[j]);
+                }
+                time[k] = durationms(now(), start) / length;
+            }
+
+            double estimate = run.distinct();
+            std::cout << "- " << run.carried->name << std::endl;
+            std::cout << "    Insert: " << time[0] << " -> " << time[1] << " ms (+" << time[1] - time[0] << ")" << std::endl;
+            std::cout << "    Distinct: " << estimate << ", RE " << std::abs(estimate - exact) / exact << std::endl;
+            delete run.plain;
+            delete run.carried;
+        }
+
+        HyperLogLog whole(DISTINCT_MEMORY), merged(DISTINCT_MEMORY);
+        std::vector<HyperLogLog*> parts;
+        for (uint32_t p = 0; p < PARTS; ++p)
+            parts.push_back(new HyperLogLog(DISTINCT_MEMORY));
+        for (uint64_t j = 0; j < length; ++j) {
+            uint64_t code = hash64(dataset[j], 0, seed);
+            whole.Insert(code);
+            parts[j * PARTS / length]->Insert(code);
+        }
+
+        const uint32_t ROUNDS = 1000;
+        TP start = now();
+        for (uint32_t r = 0; r < ROUNDS; ++r) {
+            for (auto part : parts)
+                merged.Merge(*part);
+        }
+        double mergeTime = durationms(now(), start) / ROUNDS / PARTS;
+
+        std::cout << "- Union of " << PARTS << " parts: " << merged.Estimate() << " (one estimator: " << whole.Estimate()
+                  << "), " << mergeTime << " ms per merge" << std::endl;
+        std::cout << "+------------------------------------------------+" << std::endl;
+        for (auto part : parts)
+            delete part;
+    }
+
+    /* Geometry fixed at compile time: rows (d) of the row sketches, flows per bucket of Elastic */
+    void GeometryBench(uint32_t MEMORY, double alpha) {
+        COUNT_TYPE threshold = alpha * length;
+
+        std::vector<Abstract<TUPLES>*> sketches = {
+            new CMHeap<TUPLES, COUNT_TYPE, 2>(MEMORY, "CMHeap (d=2)"),
+            new CMHeap<TUPLES, COUNT_TYPE, 3>(MEMORY, "CMHeap (d=3)"),
+            new CMHeap<TUPLES, COUNT_TYPE, 4>(MEMORY, "CMHeap (d=4)"),
+            new MVSketch<TUPLES, 2>(MEMORY, 0, "MVSketch (d=2)"),
+            new MVSketch<TUPLES, 3>(MEMORY, 0, "MVSketch (d=3)"),
+            new MVSketch<TUPLES, 4>(MEMORY, 0, "MVSketch (d=4)"),
+            new TightSketch<TUPLES, 2>(MEMORY, 0, "TightSketch (d=2)"),
+            new TightSketch<TUPLES, 3>(MEMORY, 0, "TightSketch (d=3)"),
+            new TightSketch<TUPLES, 4>(MEMORY, 0, "TightSketch (d=4)"),
+            new Elastic<TUPLES, COUNT_TYPE, 4>(MEMORY, 0, "Elastic (slots=4)"),
+            new Elastic<TUPLES, COUNT_TYPE, 8>(MEMORY, 0, "Elastic (slots=8)"),
+            new Elastic<TUPLES, COUNT_TYPE, 16>(MEMORY, 0, "Elastic (slots=16)")
+        };
+
+        for (auto sketch : sketches) {
+            RunHH(Seeded(sketch), threshold, alpha);
+            delete sketch;
+        }
+    }
+
+    void WindowBench(uint32_t MEMORY, double alpha, uint64_t WINDOW, uint32_t SUB_WINDOW) {
+        auto factory = [this](uint32_t memory) -> Abstract<TUPLES>* {
+            return Seeded(new SketchType<TUPLES>(memory));
+        };
+
+        Abstract<TUPLES>* plainSketch = factory(MEMORY);
+        Abstract<TUPLES>* windowSketch = new SlidingWindow<TUPLES>(MEMORY, WINDOW, SUB_WINDOW, factory);
+
+        std::cout << "+------------------------------------------------+" << std::endl;
+        std::cout << "- " << windowSketch->name << std::endl;
+
+        TP start, end;
+        std::cout << "- Average Time Per Insert" << std::endl;
+
+        start = now();
+        for (uint64_t j = 0; j < length; ++j) {
+            plainSketch->Insert(dataset[j]);
+        }
+        end = now();
+        double plainTime = durationms(end, start) / length;
+
+        start = now();
+        for (uint64_t j = 0; j < length; ++j) {
+            windowSketch->Insert(dataset[j]);
+        }
+        end = now();
+        double windowTime = durationms(end, start) / length;
+
+        std::cout << "    Plain: " << plainTime << " ms" << std::endl;
+        std::cout << "    Window: " << windowTime << " ms" << std::endl;
+        std::cout << "    Added: " << windowTime - plainTime << " ms" << std::endl;
+
+        /*
+         * Replay the trace against the exact counts of the live span: the last
+         * SUB_WINDOW - 1 full sub-windows plus the current one, which drop their
+         * oldest sub-window all at once as the sketches do. Once the window has
+         * filled, compare at every sub-window boundary, where the span is SPAN
+         * packets, and halfway through every sub-window, where it is about
+         * SUB_LENGTH / 2 shorter; the threshold is alpha of the live span.
+         */
+        windowSketch->Clear();
+
+        std::unordered_map<TUPLES, COUNT_TYPE> windowMp;
+        uint64_t SUB_LENGTH = std::max<uint64_t>(WINDOW / SUB_WINDOW, 1);
+        uint64_t SPAN = SUB_LENGTH * SUB_WINDOW;
+        HHMetric boundary, halfway;
+        uint32_t boundaries = 0, halfways = 0;
+
+        for (uint64_t j = 0; j < length; ++j) {
+            if (j >= SPAN && j % SUB_LENGTH == 0) {
+                for (uint64_t k = j - SPAN; k < j - SPAN + SUB_LENGTH; ++k) {
+                    auto it = windowMp.find(dataset[k]);
+                    if (--it->second == 0)
+                        windowMp.erase(it);
+                }
+            }
+            windowSketch->Insert(dataset[j]);
+            windowMp[dataset[j]] += 1;
+
+            uint64_t current = j % SUB_LENGTH + 1;
+            if (j + 1 < SPAN || (current != SUB_LENGTH && current != (SUB_LENGTH + 1) / 2))
+                continue;
+
+            COUNT_TYPE liveThreshold = alpha * (SPAN - SUB_LENGTH + current);
+            std::unordered_map<TUPLES, COUNT_TYPE> estTuple = windowSketch->AllQuery();
+            if (current == SUB_LENGTH) {
+                boundary += Evaluate(estTuple, windowMp, liveThreshold);
+                boundaries += 1;
+            }
+            else {
+                halfway += Evaluate(estTuple, windowMp, liveThreshold);
+                halfways += 1;
+            }
+        }
+
+        auto report = [](const std::string& label, const HHMetric& sum, uint32_t windows) {
+            std::cout << "- " << label << ": " << windows << " windows" << std::endl;
+            if (windows == 0)
+                return;
+            std::cout << "    Recall: " << sum.recall / windows << std::endl;
+            std::cout << "    Precision: " << sum.precision / windows << std::endl;
+            std::cout << "    F1 Socre: " << sum.f1score / windows << std::endl;
+            std::cout << "    AAE: " << sum.aae / windows << std::endl;
+            std::cout << "    ARE: " << sum.are / windows << std::endl;
+        };
+
+        std::cout << "- CompareWindowHH" << std::endl;
+        std::cout << "    Window: " << SPAN << " packets (" << SUB_WINDOW << " x " << SUB_LENGTH << ")" << std::endl;
+        std::cout << "    Threshold: " << std::fixed << alpha * 100 << "% of the live span (Packet Count: "
+                  << (COUNT_TYPE)(alpha * SPAN) << " at a boundary)" << std::endl;
+        report("At sub-window boundaries", boundary, boundaries);
+        report("Halfway through sub-windows", halfway, halfways);
+        std::cout << "+------------------------------------------------+" << std::endl;
+
+        delete plainSketch;
+        delete windowSketch;
+    }
+
+    void EpochBench(uint32_t MEMORY, double alpha, uint64_t EPOCH_LENGTH) {
+        COUNT_TYPE threshold = alpha * EPOCH_LENGTH;
+        auto factory = [this](uint32_t memory) -> Abstract<TUPLES>* {
+            return Seeded(new SketchType<TUPLES>(memory));
+        };
+
+        TP start, end, stallStart;
+        double stall, maxStall;
+        uint64_t epochs;
+
+        /* Baseline: stop inserting, report, then delete and re-create the sketch */
+        Abstract<TUPLES>* tupleSketch = factory(MEMORY);
+
+        std::cout << "+------------------------------------------------+" << std::endl;
+        std::cout << "- " << tupleSketch->name << " (stop-report-reset)" << std::endl;
+
+        stall = maxStall = 0;
+        epochs = 0;
+        start = now();
+        for (uint64_t j = 0; j < length; ++j) {
+            tupleSketch->Insert(dataset[j]);
+            if ((j + 1) % EPOCH_LENGTH == 0) {
+                stallStart = now();
+                std::unordered_map<TUPLES, COUNT_TYPE> report = tupleSketch->AllQuery();
+                delete tupleSketch;
+                tupleSketch = factory(MEMORY);
+                double duration = durationms(now(), stallStart);
+                stall += duration;
+                maxStall = std::max(maxStall, duration);
+                epochs += 1;
+            }
+        }
+        end = now();
+        delete tupleSketch;
+
+        std::cout << "    Insert: " << (durationms(end, start) / length) << " ms" << std::endl;
+        std::cout << "    Epochs: " << epochs << std::endl;
+        std::cout << "    Average Stall: " << (epochs ? stall / epochs : 0) << " ms" << std::endl;
+        std::cout << "    Max Stall: " << maxStall << " ms" << std::endl;
+
+        /* Double-buffered: reports are produced on the background thread and checked afterwards */
+        struct Report{
+            uint64_t epoch, begin, packets;
+            std::unordered_map<TUPLES, COUNT_TYPE> estTuple;
+        };
+        std::vector<Report> reports;
+        uint64_t begin = 0;
+
+        auto reporter = [&](uint64_t epoch, uint64_t packets, const std::unordered_map<TUPLES, COUNT_TYPE>& report) {
+            reports.push_back(Report{epoch, begin, packets, report});
+            begin += packets;
+        };
+
+        EpochManager<TUPLES>* manager = new EpochManager<TUPLES>(MEMORY, EPOCH_LENGTH, factory, reporter);
+
+        std::cout << "- " << manager->name << std::endl;
+
+        maxStall = 0;
+        start = now();
+        for (uint64_t j = 0; j < length; ++j) {
+            stallStart = now();
+            manager->Insert(dataset[j]);
+            maxStall = std::max(maxStall, durationms(now(), stallStart));
+        }
+        end = now();
+
+        uint64_t rotations = manager->Epoch(), delayed = manager->Delayed();
+        delete manager;
+
+        std::cout << "    Insert: " << (durationms(end, start) / length) << " ms (timed per packet)" << std::endl;
+        std::cout << "    Epochs: " << rotations << std::endl;
+        std::cout << "    Delayed Boundaries: " << delayed << std::endl;
+        std::cout << "    Max Insert: " << maxStall << " ms" << std::endl;
+
+        HHMetric sum;
+        uint64_t reported = reports.size();
+        if (reported > 0)
+            std::cout << "    Reported: epochs 0 to " << reports.back().epoch << ", " << begin << " of " << length << " packets" << std::endl;
+
+        for (auto& report : reports) {
+            std::unordered_map<TUPLES, COUNT_TYPE> epochMp;
+            for (uint64_t j = report.begin; j < report.begin + report.packets; ++j) {
+                epochMp[dataset[j]] += 1;
+            }
+            sum += Evaluate(report.estTuple, epochMp, threshold);
+        }
+
+        if (reported > 0) {
+            std::cout << "- CompareEpochHH" << std::endl;
+            std::cout << "    Threshold: " << std::fixed << alpha * 100 << "% (Packet Count: "<< threshold << ")" << std::endl;
+            std::cout << "    Recall: " << sum.recall / reported << std::endl;
+            std::cout << "    Precision: " << sum.precision / reported << std::endl;
+            std::cout << "    F1 Socre: " << sum.f1score / reported << std::endl;
+            std::cout << "    AAE: " << sum.aae / reported << std::endl;
+            std::cout << "    ARE: " << sum.are / reported << std::endl;
+        }
+        std::cout << "+------------------------------------------------+" << std::endl;
+    }
+
+    void SnapshotBench(uint32_t MEMORY, double alpha, std::string PATH) {
+        COUNT_TYPE threshold = alpha * length;
+        TP start, end;
+
+        Abstract<TUPLES>* tupleSketch = Seeded(new SketchType<TUPLES>(MEMORY));
+        for (uint64_t j = 0; j < length; ++j) {
+            tupleSketch->Insert(dataset[j]);
+        }
 
         std::cout << "+------------------------------------------------+" << std::endl;
         std::cout << "- " << tupleSketch->name << std::endl;
 
-        Throughput(tupleSketch);
+        start = now();
+        SaveSketch(tupleSketch, PATH);
+        end = now();
 
-        std::unordered_map<TUPLES, COUNT_TYPE> estTuple = tupleSketch->AllQuery();
+        std::ifstream file(PATH, std::ios::binary | std::ios::ate);
+        std::cout << "- Snapshot" << std::endl;
+        std::cout << "    Size: " << file.tellg() << " bytes" << std::endl;
+        std::cout << "    Save: " << durationms(end, start) << " ms" << std::endl;
+
+        start = now();
+        Abstract<TUPLES>* loaded = LoadSketch<TUPLES>(PATH);
+        end = now();
+        std::cout << "    Load: " << durationms(end, start) << " ms" << std::endl;
+
+        start = now();
+        Abstract<TUPLES>* mapped = OpenSketch<TUPLES>(PATH);
+        end = now();
+        std::cout << "    Open (mmap): " << durationms(end, start) << " ms" << std::endl;
+
+        uint64_t mismatch = 0;
+        start = now();
+        for (uint64_t j = 0; j < length; ++j) {
+            mismatch += (mapped->Query(dataset[j]) != tupleSketch->Query(dataset[j]));
+            mismatch += (loaded->Query(dataset[j]) != tupleSketch->Query(dataset[j]));
+        }
+        end = now();
+        std::cout << "    Query Mismatch: " << mismatch << std::endl;
+
+        start = now();
+        for (uint64_t j = 0; j < length; ++j) {
+            mapped->Query(dataset[j]);
+        }
+        end = now();
+        std::cout << "    Query (mmap): " << (durationms(end, start) / length) << " ms" << std::endl;
 
+        std::string EXPORT_PATH = PATH + ".z";
+        start = now();
+        ExportSketch(tupleSketch, EXPORT_PATH);
+        end = now();
+
+        std::ifstream exported(EXPORT_PATH, std::ios::binary | std::ios::ate);
+        std::cout << "- Compressed Export" << std::endl;
+        std::cout << "    Size: " << exported.tellg() << " bytes" << std::endl;
+        std::cout << "    Export: " << durationms(end, start) << " ms" << std::endl;
+
+        start = now();
+        Abstract<TUPLES>* imported = ImportSketch<TUPLES>(EXPORT_PATH);
+        end = now();
+        std::cout << "    Import: " << durationms(end, start) << " ms" << std::endl;
+
+        mismatch = 0;
+        for (uint64_t j = 0; j < length; ++j) {
+            mismatch += (imported->Query(dataset[j]) != tupleSketch->Query(dataset[j]));
+        }
+        std::cout << "    Query Mismatch: " << mismatch << std::endl;
+        delete imported;
+
+        std::unordered_map<TUPLES, COUNT_TYPE> estTuple = mapped->AllQuery();
         CompareHH(estTuple, tuplesMp, threshold, alpha);
         std::cout << "+------------------------------------------------+" << std::endl;
-        // printTopK(estTuple, 10000);
-        // printTopK(tuplesMp, 10);
 
+        delete mapped;
+        delete loaded;
         delete tupleSketch;
     }
 
 private:
+    struct HHMetric{
+        double recall = 0, precision = 0, f1score = 0, aae = 0, are = 0;
+
+        HHMetric& operator += (const HHMetric& other){
+            recall += other.recall;
+            precision += other.precision;
+            f1score += other.f1score;
+            aae += other.aae;
+            are += other.are;
+            return *this;
+        }
+    };
+
     std::string fileName;
+    uint32_t seed = 0;
 
     LoadResult result;
 
     TUPLES* dataset;
     uint64_t length;
 
+    /* Weighted traces only */
+    std::vector<TUPLES> tuples;
+    std::vector<COUNT_TYPE> weights;
+
     std::unordered_map<TUPLES, COUNT_TYPE> tuplesMp;
 
     template<class T>
-    void CompareHH(T mp, T record, COUNT_TYPE threshold, double alpha){
+    static HHMetric Evaluate(T& mp, T& record, COUNT_TYPE threshold){
         double realHH = 0, estHH = 0, bothHH = 0, aae = 0, are = 0;
 
         for(auto it = record.begin(); it != record.end(); ++it){
             bool real, est;
-            double realF = it->second, estF = mp[it->first];
+            auto find = mp.find(it->first);
+            double realF = it->second, estF = (find == mp.end()) ? 0 : find->second;
             
             real = (realF > threshold);
             est = (estF > threshold);
@@ -100,18 +1703,194 @@ private:
             }
         }
 
-        double recall = bothHH / realHH;
-        double precision = bothHH / estHH;
-        double f1score = 2 * (precision * recall) / (precision + recall);
+        HHMetric ret;
+        ret.recall = (realHH > 0) ? bothHH / realHH : 1;
+        ret.precision = (estHH > 0) ? bothHH / estHH : 1;
+        ret.f1score = (ret.precision + ret.recall > 0) ? 2 * (ret.precision * ret.recall) / (ret.precision + ret.recall) : 0;
+        ret.aae = (bothHH > 0) ? aae / bothHH : 0;
+        ret.are = (bothHH > 0) ? are / bothHH : 0;
+        return ret;
+    }
+
+    void RunHH(Abstract<TUPLES>* tupleSketch, COUNT_TYPE threshold, double alpha) {
+        std::cout << "+------------------------------------------------+" << std::endl;
+        std::cout << "- " << tupleSketch->name << std::endl;
+
+        Throughput(tupleSketch);
+
+        std::unordered_map<TUPLES, COUNT_TYPE> estTuple = tupleSketch->AllQuery();
+
+        CompareHH(estTuple, tuplesMp, threshold, alpha);
+        std::cout << "+------------------------------------------------+" << std::endl;
+        // printTopK(estTuple, 10000);
+    }
+
+    /*
+     * One ConcurrentBench row pair for a counter structure with InsertShared:
+     * one table filled by every thread at once, then one shard of MEMORY /
+     * threads per thread, summed at query time
+     */
+    template<typename SKETCH>
+    void SharedAndSharded(const std::string& label, uint32_t MEMORY, uint32_t threads,
+                          const std::function<double(std::function<COUNT_TYPE(const TUPLES&)>)>& sketchARE) {
+        std::string pad(std::max<int>(0, 20 - (int)label.size()), ' ');
+        {
+            SKETCH shared(MEMORY);
+            shared.Seed(seed);
+            double time = Parallel(threads, [&](uint32_t, uint64_t begin, uint64_t end) {
+                for (uint64_t j = begin; j < end; ++j)
+                    shared.InsertShared(dataset[j]);
+            });
+            double are = sketchARE([&](const TUPLES& item) { return shared.Query(item); });
+            std::cout << "    " << label << " shared:  " << pad << length / time << " Mpps, ARE: " << are << std::endl;
+        }
+
+        {
+            std::vector<SKETCH*> shards;
+            for (uint32_t t = 0; t < threads; ++t) {
+                shards.push_back(new SKETCH(MEMORY / threads));
+                shards[t]->Seed(seed);
+            }
+            double time = Parallel(threads, [&](uint32_t t, uint64_t begin, uint64_t end) {
+                for (uint64_t j = begin; j < end; ++j)
+                    shards[t]->Insert(dataset[j]);
+            });
+            double are = sketchARE([&](const TUPLES& item) {
+                COUNT_TYPE sum = 0;
+                for (auto shard : shards)
+                    sum += shard->Query(item);
+                return sum;
+            });
+            std::cout << "    " << label << " sharded: " << pad << length / time << " Mpps, ARE: " << are << std::endl;
+            for (auto shard : shards)
+                delete shard;
+        }
+    }
+
+    /* Run work(thread, begin, end) on threads slices of the trace; returns the wall time */
+    double Parallel(uint32_t threads, std::function<void(uint32_t, uint64_t, uint64_t)> work) {
+        std::vector<std::thread> workers;
+        TP start = now();
+        for (uint32_t t = 0; t < threads; ++t)
+            workers.emplace_back(work, t, length * t / threads, length * (t + 1) / threads);
+        for (auto& worker : workers)
+            worker.join();
+        return durationms(now(), start);
+    }
+
+    /* Every registered heavy-hitter sketch at MEMORY bytes */
+    std::vector<std::function<Abstract<TUPLES>*()>> Sketches(uint32_t MEMORY, COUNT_TYPE threshold) {
+        std::vector<std::function<Abstract<TUPLES>*()>> ret;
+        for (auto& entry : SketchRegistry<TUPLES>()) {
+            const SketchEntry<TUPLES>* registered = &entry;
+            ret.push_back([=]() { return registered->factory(MEMORY, threshold); });
+        }
+        return ret;
+    }
+
+    /*
+     * Run job(0), ..., job(count - 1) on workers threads, each pinned to one of
+     * the cores this process may use; returns the wall time.
+     */
+    double Pool(uint32_t workers, uint64_t count, std::function<void(uint64_t)> job) {
+        cpu_set_t allowed;
+        std::vector<uint32_t> cores;
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+            for (uint32_t cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+                if (CPU_ISSET(cpu, &allowed))
+                    cores.push_back(cpu);
+            }
+        }
+
+        std::atomic<uint64_t> next(0);
+        std::vector<std::thread> pool;
+        TP start = now();
+        for (uint32_t w = 0; w < workers; ++w) {
+            pool.emplace_back([&]() {
+                for (uint64_t i = next++; i < count; i = next++)
+                    job(i);
+            });
+            if (!cores.empty()) {
+                cpu_set_t set;
+                CPU_ZERO(&set);
+                CPU_SET(cores[w % cores.size()], &set);
+                pthread_setaffinity_np(pool.back().native_handle(), sizeof(set), &set);
+            }
+        }
+        for (auto& worker : pool)
+            worker.join();
+        return durationms(now(), start);
+    }
+
+    /* Sketches of ZeroKeyBench that miss the zero key or misestimate it */
+    template<typename KEY>
+    uint32_t ZeroKeyFailures(uint32_t MEMORY, uint64_t PACKETS, uint64_t ZERO_PACKETS, const std::string& kind,
+                             std::function<KEY(const TUPLES&)> convert) {
+        const KEY zero = KEY();
+        const uint64_t STEP = PACKETS / ZERO_PACKETS;
+        uint32_t failed = 0;
+
+        for (auto& entry : SketchRegistry<KEY>()) {
+            Abstract<KEY>* sketch = Seeded(entry.factory(MEMORY, ZERO_PACKETS / 2));
+            for (uint64_t j = 0; j < PACKETS; ++j) {
+                KEY key = convert(dataset[j]);
+                if (!(key == zero))
+                    sketch->Insert(key);
+                if (j % STEP == 0)
+                    sketch->Insert(zero);
+            }
+
+            auto all = sketch->AllQuery();
+            auto found = all.find(zero);
+            COUNT_TYPE reported = (found == all.end()) ? 0 : found->second;
+            bool lost = std::abs((double)reported - ZERO_PACKETS) > 0.1 * ZERO_PACKETS;
+            failed += lost;
+            std::cout << "    " << sketch->name << " (" << kind << "): reported " << reported
+                      << ", Query " << sketch->Query(zero) << (lost ? ", LOST" : "") << std::endl;
+            delete sketch;
+        }
+        return failed;
+    }
+
+    /* Fresh sketch with the seed of this run */
+    template<class T>
+    T* Seeded(T* sketch) {
+        sketch->Seed(seed);
+        return sketch;
+    }
+
+    /* Mean and half-width of the 95% confidence interval (Student t) */
+    static std::pair<double, double> Interval(const std::vector<double>& samples) {
+        static const double T975[] = {
+            12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+            2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+            2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+        };
+        double n = samples.size(), mean = 0, var = 0;
+        for (double x : samples)
+            mean += x / n;
+        if (n < 2)
+            return {mean, 0};
+        for (double x : samples)
+            var += (x - mean) * (x - mean) / (n - 1);
+        double t = (n - 1 <= 30) ? T975[(uint32_t)n - 2] : 1.96;
+        return {mean, t * std::sqrt(var / n)};
+    }
+
+    template<class T>
+    void CompareHH(T mp, T record, COUNT_TYPE threshold, double alpha){
+        PrintHH(Evaluate(mp, record, threshold), length, threshold, alpha);
+    }
 
+    static void PrintHH(const HHMetric& metric, uint64_t packets, COUNT_TYPE threshold, double alpha){
         std::cout << "- CompareHH" << std::endl;
-        std::cout << "    Total Packets: " << length << std::endl;
+        std::cout << "    Total Packets: " << packets << std::endl;
         std::cout << "    Threshold: " << std::fixed << alpha * 100 << "% (Packet Count: "<< threshold << ")" << std::endl;
-        std::cout << "    Recall: " << recall << std::endl;
-        std::cout << "    Precision: " << precision << std::endl;
-        std::cout << "    F1 Socre: " <<  f1score << std::endl;        
-        std::cout << "    AAE: " << aae / bothHH << std::endl;
-        std::cout << "    ARE: " << are / bothHH << std::endl;
+        std::cout << "    Recall: " << metric.recall << std::endl;
+        std::cout << "    Precision: " << metric.precision << std::endl;
+        std::cout << "    F1 Socre: " <<  metric.f1score << std::endl;        
+        std::cout << "    AAE: " << metric.aae << std::endl;
+        std::cout << "    ARE: " << metric.are << std::endl;
     }
 
     template<class T>
@@ -0,0 +1,47 @@
+#ifndef ALLOCATION_H
+#define ALLOCATION_H
+
+#include <cstdlib>
+#include <new>
+
+/*
+ * Replaces the global operator new and delete to count the allocations of the
+ * calling thread, for checking that a code path stays off the heap. Defines
+ * the replacement functions, so it belongs in one translation unit only.
+ * They are kept out of line: inlined, GCC sees malloc() and free() paired
+ * with new and delete expressions and reports mismatched deallocations.
+ */
+
+inline uint64_t& AllocationCount(){
+    static thread_local uint64_t count = 0;
+    return count;
+}
+
+__attribute__((noinline)) void* operator new(size_t size){
+    AllocationCount() += 1;
+    if(void* ptr = std::malloc(size ? size : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void* operator new[](size_t size){
+    return operator new(size);
+}
+
+__attribute__((noinline)) void operator delete(void* ptr) noexcept{
+    std::free(ptr);
+}
+
+__attribute__((noinline)) void operator delete[](void* ptr) noexcept{
+    std::free(ptr);
+}
+
+__attribute__((noinline)) void operator delete(void* ptr, size_t) noexcept{
+    std::free(ptr);
+}
+
+__attribute__((noinline)) void operator delete[](void* ptr, size_t) noexcept{
+    std::free(ptr);
+}
+
+#endif
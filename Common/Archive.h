@@ -0,0 +1,377 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+
+#include "MMap.h"
+
+#define SNAPSHOT_MAGIC 0x4b534848    /* "HHSK" */
+#define EXPORT_MAGIC 0x5a534848      /* "HHSZ" */
+#define SNAPSHOT_VERSION 6
+#define SNAPSHOT_ALIGN 8
+
+/*
+ * Snapshot file layout:
+ *   SnapshotHeader
+ *   one section per (nested) sketch: kind tag, parameters, raw tables
+ * Tables are padded to SNAPSHOT_ALIGN so that a mapped file can be queried in place.
+ */
+struct SnapshotHeader{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t keySize;
+    uint32_t countSize;
+};
+
+class Archive;
+
+/* Table elements that know which of their fields are keys and which are counts */
+template<typename T, typename = void>
+struct HasCode : std::false_type{};
+
+template<typename T>
+struct HasCode<T, decltype(std::declval<T&>().Code(std::declval<Archive&>()), void())> : std::true_type{};
+
+/*
+ * One archive object both writes and reads a snapshot, so every class describes
+ * its layout once in Serialize(Archive&).
+ *   SAVE:    write to a file
+ *   RESTORE: read from a file, tables are copied into owned memory
+ *   MAP:     read from a mapped file, tables point into the mapping (read-only)
+ *   EXPORT:  write a compressed file for transfer
+ *   IMPORT:  read a compressed file into owned memory
+ *
+ * The compressed form stores only non-zero table elements, each preceded by the
+ * varint distance from the previous one. Counts are zigzag varints and keys are
+ * dictionary-coded: a key seen before in the file costs one varint index.
+ */
+class Archive{
+public:
+    enum Mode{
+        SAVE,
+        RESTORE,
+        MAP,
+        EXPORT,
+        IMPORT
+    };
+
+    Archive(const std::string& path, Mode _mode){
+        mode = _mode;
+        offset = 0;
+        file = {nullptr, 0};
+
+        if(!Loading()){
+            out.open(path, std::ios::binary | std::ios::trunc);
+            if(!out)
+                throw std::runtime_error("Cannot write snapshot " + path);
+        }
+        else{
+            file = Load(path.c_str());
+        }
+    }
+
+    ~Archive(){
+        if(file.start != nullptr)
+            UnLoad(file);
+    }
+
+    inline bool Loading() const{
+        return mode == RESTORE || mode == MAP || mode == IMPORT;
+    }
+
+    inline bool Compressed() const{
+        return mode == EXPORT || mode == IMPORT;
+    }
+
+    inline bool Mapped() const{
+        return mode == MAP;
+    }
+
+    /* Write or check the file header */
+    void Header(uint32_t keySize, uint32_t countSize){
+        uint32_t magic = Compressed() ? EXPORT_MAGIC : SNAPSHOT_MAGIC;
+        SnapshotHeader header = {magic, SNAPSHOT_VERSION, keySize, countSize};
+        SnapshotHeader stored = header;
+        Value(stored);
+
+        if(stored.magic != magic)
+            throw std::runtime_error(Compressed() ? "Not a compressed sketch export" : "Not a sketch snapshot");
+        if(stored.version != SNAPSHOT_VERSION)
+            throw std::runtime_error("Unsupported snapshot version " + std::to_string(stored.version));
+        if(stored.keySize != keySize || stored.countSize != countSize)
+            throw std::runtime_error("Snapshot key or counter size does not match");
+    }
+
+    /* Start the section of one sketch; on load the stored kind must match */
+    void Section(uint32_t kind){
+        uint32_t stored = kind;
+        Value(stored);
+        if(stored != kind)
+            throw std::runtime_error("Snapshot section " + std::to_string(stored) +
+                                     " where " + std::to_string(kind) + " was expected");
+    }
+
+    /* Kind of the next section, without consuming it */
+    uint32_t Peek(){
+        uint32_t kind;
+        Fetch(&kind, sizeof(kind));
+        offset -= sizeof(kind);
+        return kind;
+    }
+
+    /* Mark an object whose tables were handed out by this archive */
+    inline void Attach(bool& mapped) const{
+        if(Loading())
+            mapped = (mode == MAP);
+    }
+
+    template<typename T>
+    void Value(T& value){
+        if(!Loading())
+            Write(&value, sizeof(T));
+        else
+            Fetch(&value, sizeof(T));
+    }
+
+    /* Compile-time geometry: written on save, must be identical on load */
+    template<typename T>
+    void Param(T value){
+        T stored = value;
+        Value(stored);
+        if(memcmp(&stored, &value, sizeof(T)) != 0)
+            throw std::runtime_error("Snapshot was written with a different sketch geometry");
+    }
+
+    void String(std::string& str){
+        uint32_t size = str.size();
+        Value(size);
+        if(!Loading()){
+            Write(str.data(), size);
+        }
+        else{
+            str.resize(size);
+            Fetch(&str[0], size);
+        }
+    }
+
+    template<typename T>
+    void Array(T*& array, uint64_t length){
+        if(Compressed()){
+            if(mode == IMPORT)
+                array = new T[length];
+            Sparse(array, length);
+            return;
+        }
+
+        Align();
+        uint64_t bytes = sizeof(T) * length;
+
+        if(mode == SAVE){
+            Write(array, bytes);
+        }
+        else if(mode == RESTORE){
+            array = new T[length];
+            Fetch(array, bytes);
+        }
+        else{
+            Check(bytes);
+            array = (T*)((uint8_t*)file.start + offset);
+            offset += bytes;
+        }
+    }
+
+    template<typename T>
+    void Vector(std::vector<T>& vec){
+        uint64_t length = vec.size();
+        Value(length);
+
+        if(Compressed()){
+            if(mode == IMPORT)
+                vec.resize(length);
+            Sparse(vec.data(), length);
+            return;
+        }
+
+        Align();
+
+        if(mode == SAVE){
+            Write(vec.data(), sizeof(T) * length);
+        }
+        else{
+            vec.resize(length);
+            Fetch(vec.data(), sizeof(T) * length);
+        }
+    }
+
+    /* Field of a table element in compressed mode */
+    template<typename T>
+    void Key(T& key){
+        if(mode == EXPORT){
+            std::string bytes((const char*)&key, sizeof(T));
+            auto it = dictionary.find(bytes);
+            if(it != dictionary.end()){
+                Varint(it->second + 1);
+            }
+            else{
+                Varint(0);
+                Write(&key, sizeof(T));
+                uint32_t index = dictionary.size();
+                dictionary[bytes] = index;
+            }
+        }
+        else{
+            uint64_t index = Varint();
+            if(index == 0){
+                Fetch(&key, sizeof(T));
+                keys.push_back(std::string((const char*)&key, sizeof(T)));
+            }
+            else{
+                if(index > keys.size() || keys[index - 1].size() != sizeof(T))
+                    throw std::runtime_error("Corrupted key dictionary");
+                memcpy(&key, keys[index - 1].data(), sizeof(T));
+            }
+        }
+    }
+
+    /* Field of a table element in compressed mode */
+    template<typename T>
+    void Count(T& count){
+        if(mode == EXPORT){
+            int64_t value = count;
+            Varint(((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+        }
+        else{
+            uint64_t value = Varint();
+            count = (T)(int64_t)((value >> 1) ^ (~(value & 1) + 1));
+        }
+    }
+
+    /* Hand the mapping over to the loaded sketch, which unmaps it when destroyed */
+    LoadResult Release(){
+        LoadResult ret = file;
+        file = {nullptr, 0};
+        return ret;
+    }
+
+private:
+    Mode mode;
+    uint64_t offset;
+
+    std::ofstream out;
+    LoadResult file;
+
+    std::unordered_map<std::string, uint32_t> dictionary;
+    std::vector<std::string> keys;
+
+    void Varint(uint64_t value){
+        uint8_t buffer[10];
+        uint32_t size = 0;
+        while(value >= 0x80){
+            buffer[size++] = (uint8_t)(value | 0x80);
+            value >>= 7;
+        }
+        buffer[size++] = (uint8_t)value;
+        Write(buffer, size);
+    }
+
+    uint64_t Varint(){
+        uint64_t value = 0;
+        for(uint32_t shift = 0;shift < 64;shift += 7){
+            uint8_t byte;
+            Fetch(&byte, 1);
+            value |= (uint64_t)(byte & 0x7f) << shift;
+            if(!(byte & 0x80))
+                return value;
+        }
+        throw std::runtime_error("Corrupted varint");
+    }
+
+    /* Non-zero elements only: count, then (gap, element) pairs */
+    template<typename T>
+    void Sparse(T* array, uint64_t length){
+        if(mode == EXPORT){
+            static const T zero = T();
+            uint64_t nonzero = 0;
+            for(uint64_t i = 0;i < length;++i)
+                nonzero += (memcmp(&array[i], &zero, sizeof(T)) != 0);
+            Varint(nonzero);
+
+            uint64_t last = 0;
+            for(uint64_t i = 0;i < length;++i){
+                if(memcmp(&array[i], &zero, sizeof(T)) != 0){
+                    Varint(i - last);
+                    Element(array[i]);
+                    last = i;
+                }
+            }
+        }
+        else{
+            memset((void*)array, 0, sizeof(T) * length);
+            uint64_t nonzero = Varint(), last = 0;
+            for(uint64_t i = 0;i < nonzero;++i){
+                last += Varint();
+                if(last >= length)
+                    throw std::runtime_error("Corrupted sparse table");
+                Element(array[last]);
+            }
+        }
+    }
+
+    template<typename T>
+    void Element(T& element){
+        Element(element, std::integral_constant<int, std::is_arithmetic<T>::value ? 0 : (HasCode<T>::value ? 1 : 2)>());
+    }
+
+    template<typename T>
+    void Element(T& element, std::integral_constant<int, 0>){
+        Count(element);
+    }
+
+    template<typename T>
+    void Element(T& element, std::integral_constant<int, 1>){
+        element.Code(*this);
+    }
+
+    template<typename T>
+    void Element(T& element, std::integral_constant<int, 2>){
+        if(mode == EXPORT)
+            Write(&element, sizeof(T));
+        else
+            Fetch(&element, sizeof(T));
+    }
+
+    void Write(const void* data, uint64_t bytes){
+        out.write((const char*)data, bytes);
+        if(!out)
+            throw std::runtime_error("Snapshot write failed");
+        offset += bytes;
+    }
+
+    void Fetch(void* data, uint64_t bytes){
+        Check(bytes);
+        memcpy(data, (uint8_t*)file.start + offset, bytes);
+        offset += bytes;
+    }
+
+    inline void Check(uint64_t bytes){
+        if(offset + bytes > file.length)
+            throw std::runtime_error("Snapshot is truncated");
+    }
+
+    void Align(){
+        static const uint8_t padding[SNAPSHOT_ALIGN] = {0};
+        uint64_t pad = (SNAPSHOT_ALIGN - offset % SNAPSHOT_ALIGN) % SNAPSHOT_ALIGN;
+
+        if(!Loading())
+            Write(padding, pad);
+        else
+            offset += pad;
+    }
+};
+
+#endif
@@ -0,0 +1,272 @@
+#ifndef DISPATCH_H
+#define DISPATCH_H
+
+/*
+ * Kernels built for several instruction sets in the one binary, so a build
+ * without -march still uses AVX2 or AVX-512 where the CPU has them. The best
+ * variant the CPU supports is picked from CPUID on first use; every variant
+ * returns exactly what the generic one does, so results and snapshots do not
+ * depend on the machine. Included from Util.h, after the standard headers and
+ * the word-sized hash specializations, above the pack pragma.
+ *   HashKeys: BOBHash32 of many keys of one length, one key per vector lane.
+ *   MaxBytes: target[i] = max(target[i], source[i]), the HyperLogLog merge.
+ */
+struct Kernels{
+    const char* name;
+    /* out[k] = BOBHash32 of the length bytes at base + index[k] * length, or base + k * length without index */
+    void (*HashKeys)(const uint8_t* base, uint32_t length, const uint32_t* index, uint32_t n,
+                     uint32_t num, uint32_t seed, uint32_t* out);
+    void (*MaxBytes)(uint8_t* target, const uint8_t* source, size_t n);
+};
+
+namespace Dispatch{
+
+inline void HashKeysGeneric(const uint8_t* base, uint32_t length, const uint32_t* index, uint32_t n,
+                            uint32_t num, uint32_t seed, uint32_t* out){
+    for(uint32_t k = 0;k < n;++k)
+        out[k] = Hash::BOBHash32(base + (size_t)(index ? index[k] : k) * length, length, num, seed);
+}
+
+inline void MaxBytesGeneric(uint8_t* target, const uint8_t* source, size_t n){
+    size_t i = 0;
+    for(;i + 16 <= n;i += 16){
+        __m128i a = _mm_loadu_si128((const __m128i*)(target + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(source + i));
+        _mm_storeu_si128((__m128i*)(target + i), _mm_max_epu8(a, b));
+    }
+    for(;i < n;++i)
+        target[i] = std::max(target[i], source[i]);
+}
+
+/* The mix of BOBHash32 on vectors of 32-bit lanes */
+#define VECTOR_MIX(a, b, c, SUB, XOR, SRL, SLL) \
+{ \
+    a = SUB(SUB(a, b), c); a = XOR(a, SRL(c, 13)); \
+    b = SUB(SUB(b, c), a); b = XOR(b, SLL(a, 8)); \
+    c = SUB(SUB(c, a), b); c = XOR(c, SRL(b, 13)); \
+    a = SUB(SUB(a, b), c); a = XOR(a, SRL(c, 12)); \
+    b = SUB(SUB(b, c), a); b = XOR(b, SLL(a, 16)); \
+    c = SUB(SUB(c, a), b); c = XOR(c, SRL(b, 5)); \
+    a = SUB(SUB(a, b), c); a = XOR(a, SRL(c, 3)); \
+    b = SUB(SUB(b, c), a); b = XOR(b, SLL(a, 10)); \
+    c = SUB(SUB(c, a), b); c = XOR(c, SRL(b, 15)); \
+}
+
+/*
+ * BOBHash32 with one key per lane. LOAD(p, r) reads the r <= 4 bytes at p of
+ * every key as a little-endian word; a partial word is the top of the whole
+ * word ending at its last byte, so no lane reads outside its key. Keys
+ * shorter than a word take the generic path.
+ */
+#define VECTOR_BOBHASH(VEC, SET1, ADD, SUB, XOR, SRL, SLL, LOAD) \
+{ \
+    VEC a = SET1(0x9e3779b9), b = a, c = SET1(prime[num] ^ seed); \
+    uint32_t len = length, pos = 0; \
+    while(len >= 12){ \
+        a = ADD(a, LOAD(pos, 4)); \
+        b = ADD(b, LOAD(pos + 4, 4)); \
+        c = ADD(c, LOAD(pos + 8, 4)); \
+        VECTOR_MIX(a, b, c, SUB, XOR, SRL, SLL); \
+        pos += 12; len -= 12; \
+    } \
+    c = ADD(c, SET1(len)); \
+    if(len > 8) \
+        c = ADD(c, SLL(LOAD(pos + 8, len - 8), 8)); \
+    if(len > 4) \
+        b = ADD(b, LOAD(pos + 4, std::min<uint32_t>(len - 4, 4))); \
+    if(len > 0) \
+        a = ADD(a, LOAD(pos, std::min<uint32_t>(len, 4))); \
+    VECTOR_MIX(a, b, c, SUB, XOR, SRL, SLL); \
+    hashed = c; \
+}
+
+/*
+ * Gather offsets are signed 32-bit lanes. Without index every vector gathers
+ * near its own first key, so the lane offsets stay below 16 keys; index[k] *
+ * length can pass 2^31, so those offsets take two gathers of 64-bit lanes.
+ */
+__attribute__((target("avx2")))
+inline __m256i LoadAVX2(const uint8_t* base, __m256i offset, uint32_t pos, uint32_t bytes){
+    __m256i word = _mm256_i32gather_epi32((const int*)(base + pos + bytes - 4), offset, 1);
+    return (bytes == 4) ? word : _mm256_srl_epi32(word, _mm_cvtsi32_si128(32 - 8 * bytes));
+}
+
+__attribute__((target("avx2")))
+inline __m256i LoadWideAVX2(const uint8_t* base, __m256i low, __m256i high, uint32_t pos, uint32_t bytes){
+    const int* start = (const int*)(base + pos + bytes - 4);
+    __m256i word = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm256_i64gather_epi32(start, low, 1)),
+                                           _mm256_i64gather_epi32(start, high, 1), 1);
+    return (bytes == 4) ? word : _mm256_srl_epi32(word, _mm_cvtsi32_si128(32 - 8 * bytes));
+}
+
+__attribute__((target("avx2")))
+inline void HashKeysAVX2(const uint8_t* base, uint32_t length, const uint32_t* index, uint32_t n,
+                         uint32_t num, uint32_t seed, uint32_t* out){
+    uint32_t k = 0;
+    if(length >= 4 && index){
+        __m256i stride = _mm256_set1_epi64x(length);
+        for(;k + 8 <= n;k += 8){
+            __m256i position = _mm256_loadu_si256((const __m256i*)(index + k));
+            __m256i low = _mm256_mul_epu32(_mm256_cvtepu32_epi64(_mm256_castsi256_si128(position)), stride);
+            __m256i high = _mm256_mul_epu32(_mm256_cvtepu32_epi64(_mm256_extracti128_si256(position, 1)), stride);
+            __m256i hashed;
+#define LOAD(pos, bytes) LoadWideAVX2(base, low, high, pos, bytes)
+            VECTOR_BOBHASH(__m256i, _mm256_set1_epi32, _mm256_add_epi32, _mm256_sub_epi32, _mm256_xor_si256,
+                           _mm256_srli_epi32, _mm256_slli_epi32, LOAD);
+#undef LOAD
+            _mm256_storeu_si256((__m256i*)(out + k), hashed);
+        }
+    }
+    else if(length >= 4){
+        __m256i offset = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(length));
+        for(;k + 8 <= n;k += 8){
+            const uint8_t* first = base + (size_t)k * length;
+            __m256i hashed;
+#define LOAD(pos, bytes) LoadAVX2(first, offset, pos, bytes)
+            VECTOR_BOBHASH(__m256i, _mm256_set1_epi32, _mm256_add_epi32, _mm256_sub_epi32, _mm256_xor_si256,
+                           _mm256_srli_epi32, _mm256_slli_epi32, LOAD);
+#undef LOAD
+            _mm256_storeu_si256((__m256i*)(out + k), hashed);
+        }
+    }
+    if(index)
+        HashKeysGeneric(base, length, index + k, n - k, num, seed, out + k);
+    else
+        HashKeysGeneric(base + (size_t)k * length, length, nullptr, n - k, num, seed, out + k);
+}
+
+__attribute__((target("avx2")))
+inline void MaxBytesAVX2(uint8_t* target, const uint8_t* source, size_t n){
+    size_t i = 0;
+    for(;i + 32 <= n;i += 32){
+        __m256i a = _mm256_loadu_si256((const __m256i*)(target + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(source + i));
+        _mm256_storeu_si256((__m256i*)(target + i), _mm256_max_epu8(a, b));
+    }
+    MaxBytesGeneric(target + i, source + i, n - i);
+}
+
+/*
+ * The AVX-512 shifts and gather of GCC 12 merge into _mm512_undefined_epi32(),
+ * which -Wmaybe-uninitialized reports once inlined; these, and the zero-masked
+ * forms below, give the same instructions without it
+ */
+__attribute__((target("avx512f")))
+inline __m512i ShiftRightAVX512(__m512i x, uint32_t bits){
+    return (__m512i)((__v16su)x >> bits);
+}
+
+__attribute__((target("avx512f")))
+inline __m512i ShiftLeftAVX512(__m512i x, uint32_t bits){
+    return (__m512i)((__v16su)x << bits);
+}
+
+__attribute__((target("avx512f")))
+inline __m512i LoadAVX512(const uint8_t* base, __m512i offset, uint32_t pos, uint32_t bytes){
+    __m512i word = _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), (__mmask16)0xffff, offset,
+                                               (const void*)(base + pos + bytes - 4), 1);
+    return (bytes == 4) ? word : ShiftRightAVX512(word, 32 - 8 * bytes);
+}
+
+__attribute__((target("avx512f")))
+inline __m512i LoadWideAVX512(const uint8_t* base, __m512i low, __m512i high, uint32_t pos, uint32_t bytes){
+    const void* start = (const void*)(base + pos + bytes - 4);
+    __m256i first = _mm512_mask_i64gather_epi32(_mm256_setzero_si256(), (__mmask8)0xff, low, start, 1);
+    __m256i second = _mm512_mask_i64gather_epi32(_mm256_setzero_si256(), (__mmask8)0xff, high, start, 1);
+    __m512i word = _mm512_mask_broadcast_i64x4(_mm512_maskz_broadcast_i64x4((__mmask8)0x0f, first), (__mmask8)0xf0, second);
+    return (bytes == 4) ? word : ShiftRightAVX512(word, 32 - 8 * bytes);
+}
+
+__attribute__((target("avx512f")))
+inline void HashKeysAVX512(const uint8_t* base, uint32_t length, const uint32_t* index, uint32_t n,
+                           uint32_t num, uint32_t seed, uint32_t* out){
+    uint32_t k = 0;
+    if(length >= 4 && index){
+        __m512i stride = _mm512_set1_epi64(length);
+        for(;k + 16 <= n;k += 16){
+            __m512i low = _mm512_maskz_mul_epu32((__mmask8)0xff, _mm512_maskz_cvtepu32_epi64((__mmask8)0xff, _mm256_loadu_si256((const __m256i*)(index + k))), stride);
+            __m512i high = _mm512_maskz_mul_epu32((__mmask8)0xff, _mm512_maskz_cvtepu32_epi64((__mmask8)0xff, _mm256_loadu_si256((const __m256i*)(index + k + 8))), stride);
+            __m512i hashed;
+#define LOAD(pos, bytes) LoadWideAVX512(base, low, high, pos, bytes)
+            VECTOR_BOBHASH(__m512i, _mm512_set1_epi32, _mm512_add_epi32, _mm512_sub_epi32, _mm512_xor_si512,
+                           ShiftRightAVX512, ShiftLeftAVX512, LOAD);
+#undef LOAD
+            _mm512_storeu_si512((void*)(out + k), hashed);
+        }
+    }
+    else if(length >= 4){
+        __m512i offset = _mm512_mullo_epi32(_mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15),
+                                            _mm512_set1_epi32(length));
+        for(;k + 16 <= n;k += 16){
+            const uint8_t* first = base + (size_t)k * length;
+            __m512i hashed;
+#define LOAD(pos, bytes) LoadAVX512(first, offset, pos, bytes)
+            VECTOR_BOBHASH(__m512i, _mm512_set1_epi32, _mm512_add_epi32, _mm512_sub_epi32, _mm512_xor_si512,
+                           ShiftRightAVX512, ShiftLeftAVX512, LOAD);
+#undef LOAD
+            _mm512_storeu_si512((void*)(out + k), hashed);
+        }
+    }
+    if(index)
+        HashKeysAVX2(base, length, index + k, n - k, num, seed, out + k);
+    else
+        HashKeysAVX2(base + (size_t)k * length, length, nullptr, n - k, num, seed, out + k);
+}
+
+__attribute__((target("avx512bw")))
+inline void MaxBytesAVX512(uint8_t* target, const uint8_t* source, size_t n){
+    size_t i = 0;
+    for(;i + 64 <= n;i += 64){
+        __m512i a = _mm512_loadu_si512((const void*)(target + i));
+        __m512i b = _mm512_loadu_si512((const void*)(source + i));
+        _mm512_storeu_si512((void*)(target + i), _mm512_max_epu8(a, b));
+    }
+    MaxBytesAVX2(target + i, source + i, n - i);
+}
+
+#undef VECTOR_BOBHASH
+#undef VECTOR_MIX
+
+}
+
+/* Every variant this CPU can run, best first; the last is always the generic one */
+inline std::vector<Kernels> SupportedKernels(){
+    std::vector<Kernels> ret;
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+        ret.push_back({"avx512", Dispatch::HashKeysAVX512, Dispatch::MaxBytesAVX512});
+    if(__builtin_cpu_supports("avx2"))
+        ret.push_back({"avx2", Dispatch::HashKeysAVX2, Dispatch::MaxBytesAVX2});
+    ret.push_back({"generic", Dispatch::HashKeysGeneric, Dispatch::MaxBytesGeneric});
+    return ret;
+}
+
+/* The variant in use, chosen once */
+inline const Kernels& CpuKernels(){
+    static const Kernels kernels = SupportedKernels().front();
+    return kernels;
+}
+
+/*
+ * hash(keys[index[k]], num, seed) for k < n, or of keys[k] without index,
+ * through the vector kernel for the keys hashed with BOBHash32; word-sized
+ * keys use their scalar hash
+ */
+template<typename T>
+inline void HashBatch(const T* keys, const uint32_t* index, uint32_t n, uint32_t num, uint32_t seed, uint32_t* out){
+    CpuKernels().HashKeys((const uint8_t*)keys, sizeof(T), index, n, num, seed, out);
+}
+
+template<>
+inline void HashBatch<uint32_t>(const uint32_t* keys, const uint32_t* index, uint32_t n, uint32_t num, uint32_t seed, uint32_t* out){
+    for(uint32_t k = 0;k < n;++k)
+        out[k] = hash(keys[index ? index[k] : k], num, seed);
+}
+
+template<>
+inline void HashBatch<uint64_t>(const uint64_t* keys, const uint32_t* index, uint32_t n, uint32_t num, uint32_t seed, uint32_t* out){
+    for(uint32_t k = 0;k < n;++k)
+        out[k] = hash(keys[index ? index[k] : k], num, seed);
+}
+
+#endif
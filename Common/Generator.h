@@ -0,0 +1,222 @@
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+#include "Util.h"
+
+/*
+ * Synthetic trace of TUPLES in the dataset format. Packets pick one of FLOWS
+ * flows by a Zipf law of exponent SKEW over popularity ranks (0 is uniform),
+ * drawn by rejection-inversion in O(1) whatever the flow count. A pick is
+ * repeated as a train of back-to-back packets, geometric with mean BURST, and
+ * every CHURN packets the ranking rotates by about 0.38 FLOWS, so the heavy
+ * hitters of one epoch are middling flows of the next (0 keeps it fixed).
+ * FANOUT consecutive flows share a source address, so the sources of the
+ * popular flows are super-spreaders. With SUBNETS, every source lies in one
+ * of that many /16 networks. The networks are skewed: about a 1/3 power law,
+ * so the first few hold most sources and the srcIP hierarchy has heavy
+ * prefixes. Without it, sources are spread over the whole address space.
+ * The trace is made of blocks of BLOCK packets, each drawn from its own random
+ * stream, so blocks are generated in parallel and the trace depends on the
+ * seed only, not on the thread count; a train does not cross a block.
+ */
+class Generator{
+public:
+    static constexpr uint64_t BLOCK = 1 << 16;
+    typedef std::function<void(const TUPLES*, uint64_t)> Consumer;
+
+    Generator(uint64_t _FLOWS, double _SKEW = 1.0, double _BURST = 1, uint64_t _CHURN = 0,
+              uint64_t _FANOUT = 1, uint64_t _SUBNETS = 0, uint32_t _seed = 0){
+        if(_FLOWS == 0)
+            throw std::invalid_argument("Generator needs at least one flow");
+        if(_SKEW < 0)
+            throw std::invalid_argument("Generator skew must not be negative");
+        if(_BURST < 1)
+            throw std::invalid_argument("Generator mean burst must be at least one packet");
+        if(_FANOUT == 0)
+            throw std::invalid_argument("Generator needs at least one flow per source");
+
+        FLOWS = _FLOWS;
+        SKEW = _SKEW;
+        BURST = _BURST;
+        CHURN = _CHURN;
+        FANOUT = _FANOUT;
+        SUBNETS = _SUBNETS;
+        STRIDE = (uint64_t)(FLOWS * 0.381966) % FLOWS;
+        seed = _seed;
+
+        hIntegralX1 = HIntegral(1.5) - 1;
+        hIntegralN = HIntegral(FLOWS + 0.5);
+        s = 2 - HIntegralInverse(HIntegral(2.5) - H(2));
+    }
+
+    /* The packets [BLOCK * block, BLOCK * block + count) of the trace, count <= BLOCK */
+    void Block(uint64_t block, TUPLES* out, uint64_t count) const{
+        Random random(hash64(block, 0, seed));
+        uint64_t begin = block * BLOCK;
+
+        for(uint64_t i = 0;i < count;){
+            uint64_t rank = Sample(random) - 1;
+            uint64_t epoch = CHURN ? (begin + i) / CHURN : 0;
+            TUPLES tuple = Tuple((rank + (epoch % FLOWS) * STRIDE) % FLOWS);
+
+            uint64_t train = (BURST > 1) ? GeometricTrials(1 / BURST, random) : 1;
+            for(;train > 0 && i < count;--train, ++i)
+                out[i] = tuple;
+        }
+    }
+
+    /* The first PACKETS packets into out, on THREADS threads */
+    void Fill(TUPLES* out, uint64_t PACKETS, uint32_t THREADS) const{
+        uint64_t BLOCKS = (PACKETS + BLOCK - 1) / BLOCK;
+        std::atomic<uint64_t> next(0);
+
+        auto job = [&](){
+            for(uint64_t k = next++;k < BLOCKS;k = next++)
+                Block(k, out + k * BLOCK, std::min(BLOCK, PACKETS - k * BLOCK));
+        };
+        std::vector<std::thread> workers;
+        for(uint32_t t = 1;t < THREADS;++t)
+            workers.emplace_back(job);
+        job();
+        for(auto& worker : workers)
+            worker.join();
+    }
+
+    /*
+     * The first PACKETS packets handed to consume(packets, count) one block at a
+     * time and in order, on the calling thread, while THREADS threads generate
+     * the blocks ahead of it; memory stays at a few blocks per thread
+     */
+    void Stream(uint64_t PACKETS, uint32_t THREADS, const Consumer& consume) const{
+        THREADS = std::max<uint32_t>(THREADS, 1);
+        const uint64_t BLOCKS = (PACKETS + BLOCK - 1) / BLOCK, RING = 2 * THREADS;
+
+        std::vector<std::vector<TUPLES>> buffers(RING, std::vector<TUPLES>(BLOCK));
+        std::vector<uint64_t> held(RING, UINT64_MAX);
+        uint64_t consumed = 0;
+        std::atomic<uint64_t> next(0);
+        std::mutex lock;
+        std::condition_variable changed;
+
+        auto job = [&](){
+            for(uint64_t k = next++;k < BLOCKS;k = next++){
+                {
+                    std::unique_lock<std::mutex> guard(lock);
+                    changed.wait(guard, [&]() { return k < consumed + RING; });
+                }
+                Block(k, buffers[k % RING].data(), std::min(BLOCK, PACKETS - k * BLOCK));
+                {
+                    std::lock_guard<std::mutex> guard(lock);
+                    held[k % RING] = k;
+                }
+                changed.notify_all();
+            }
+        };
+        std::vector<std::thread> workers;
+        for(uint32_t t = 0;t < THREADS;++t)
+            workers.emplace_back(job);
+
+        for(uint64_t k = 0;k < BLOCKS;++k){
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                changed.wait(guard, [&]() { return held[k % RING] == k; });
+            }
+            consume(buffers[k % RING].data(), std::min(BLOCK, PACKETS - k * BLOCK));
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                consumed = k + 1;
+            }
+            changed.notify_all();
+        }
+        for(auto& worker : workers)
+            worker.join();
+    }
+
+    /* The first PACKETS packets written to PATH as a dataset, streamed */
+    void Write(const std::string& PATH, uint64_t PACKETS, uint32_t THREADS) const{
+        std::ofstream out(PATH, std::ios::binary);
+        if(!out)
+            throw std::runtime_error("Cannot write trace " + PATH);
+        Stream(PACKETS, THREADS, [&](const TUPLES* packets, uint64_t count){
+            out.write((const char*)packets, count * sizeof(TUPLES));
+        });
+        if(!out)
+            throw std::runtime_error("Cannot write trace " + PATH);
+    }
+
+    /* The 5-tuple of flow id: the address of its source, hashed dstIP and ports, TCP or UDP */
+    TUPLES Tuple(uint64_t id) const{
+        uint64_t first = hash64(id, 0, seed), second = hash64(id, 1, seed);
+        uint32_t source = Source(id / FANOUT);
+        TUPLES ret;
+        memcpy(ret.data, &first, 8);
+        memcpy(ret.data, &source, 4);
+        memcpy(ret.data + 8, &second, 4);
+        ret.data[12] = (second >> 32) & 1 ? 6 : 17;
+        return ret;
+    }
+
+    /* srcIP of a source, in network byte order: hashed, or a hashed host in its subnet */
+    uint32_t Source(uint64_t source) const{
+        uint64_t hashed = hash64(source, 0, seed);
+        if(SUBNETS == 0)
+            return hashed;
+
+        double u = (hash64(source, 2, seed) >> 11) * (1.0 / 9007199254740992.0);
+        uint64_t subnet = std::min<uint64_t>(SUBNETS * u * u * u, SUBNETS - 1);
+        uint32_t network = hash64(subnet, 3, seed) & 0xffff0000;
+        return htonl(network | (hashed & 0xffff));
+    }
+
+private:
+    uint64_t FLOWS;
+    double SKEW;
+    double BURST;
+    uint64_t CHURN;
+    uint64_t FANOUT;
+    uint64_t SUBNETS;
+    uint64_t STRIDE;
+    uint32_t seed;
+
+    /* Rejection-inversion (Hoermann and Derflinger), with the constants of the exponent */
+    double hIntegralX1, hIntegralN, s;
+
+    /* Rank in [1, FLOWS] */
+    inline uint64_t Sample(Random& random) const{
+        while(true){
+            double u = hIntegralN + random.Uniform() * (hIntegralX1 - hIntegralN);
+            double x = HIntegralInverse(u);
+            uint64_t k = std::min<double>(std::max<double>(x + 0.5, 1), FLOWS);
+            if(k - x <= s || u >= HIntegral(k + 0.5) - H(k))
+                return k;
+        }
+    }
+
+    inline double H(double x) const{
+        return std::exp(-SKEW * std::log(x));
+    }
+
+    /* Integral of H from 1, (x^(1 - SKEW) - 1) / (1 - SKEW) or log x */
+    inline double HIntegral(double x) const{
+        double logX = std::log(x);
+        return ExpM1Ratio((1 - SKEW) * logX) * logX;
+    }
+
+    inline double HIntegralInverse(double x) const{
+        double t = std::max(x * (1 - SKEW), -1.0);
+        return std::exp(Log1pRatio(t) * x);
+    }
+
+    /* log1p(x) / x and expm1(x) / x, 1 at x = 0 */
+    static inline double Log1pRatio(double x){
+        return (std::abs(x) > 1e-8) ? std::log1p(x) / x : 1 - x * (0.5 - x * (1.0 / 3 - 0.25 * x));
+    }
+
+    static inline double ExpM1Ratio(double x){
+        return (std::abs(x) > 1e-8) ? std::expm1(x) / x : 1 + x * 0.5 * (1 + x / 3 * (1 + 0.25 * x));
+    }
+};
+
+constexpr uint64_t Generator::BLOCK;
+
+#endif
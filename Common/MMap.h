@@ -3,8 +3,12 @@
 
 #include <fcntl.h>
 #include <stdint.h>
+#include <unistd.h>
 
-#include <iostream>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <stdexcept>
 
 struct LoadResult{
     void* start;
@@ -22,24 +26,25 @@ LoadResult Load(const char* PATH){
     LoadResult ret;
 
     int32_t fd = open(PATH, O_RDONLY);
-    if(fd == -1) {
-        std::cerr << "Cannot open " << PATH << std::endl;
-        throw;
-    }
+    if(fd == -1)
+        throw std::runtime_error(std::string("Cannot open ") + PATH + ": " + strerror(errno));
 
     struct stat sb;
     if(fstat(fd, &sb) == -1){
-        std::cerr << "Fstat Error" << std::endl;
-        throw;
+        int error = errno;
+        close(fd);
+        throw std::runtime_error(std::string("Cannot stat ") + PATH + ": " + strerror(error));
     }
 
     ret.length = sb.st_size;
     ret.start = mmap(nullptr, ret.length, PROT_READ, MAP_PRIVATE, fd, 0u);
+    int error = errno;
+    /* The mapping keeps its own reference to the file */
+    close(fd);
 
-    if (ret.start == MAP_FAILED) {
-        std::cerr << "Cannot mmap " << PATH << " of length " << ret.length << std::endl;
-        throw;
-    }
+    if (ret.start == MAP_FAILED)
+        throw std::runtime_error(std::string("Cannot mmap ") + PATH + " of length "
+                                 + std::to_string(ret.length) + ": " + strerror(error));
 
     return ret;
 }
@@ -3,13 +3,41 @@
 
 #include <x86intrin.h>
 
+#include <map>
+#include <string>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
 #include <vector>
 #include <chrono>
 #include <algorithm>
 #include <functional>
+#include <memory>
+#include <new>
+#include <cmath>
+#include <arpa/inet.h>
 
 #include "hash.h"
 
+/* Word-sized keys skip the byte loop of BOBHash */
+template<>
+inline uint32_t hash<uint32_t>(const uint32_t& data, uint32_t num, uint32_t seed){
+    return Hash::MixHash(data, num, seed);
+}
+
+template<>
+inline uint32_t hash<uint64_t>(const uint64_t& data, uint32_t num, uint32_t seed){
+    return Hash::MixHash(data, num, seed);
+}
+
+#include "Dispatch.h"
+
+/* Standard headers with out-of-line library code must be included above the pack pragma */
+
 #pragma pack(1)
 
 #define TUPLES_LEN 13
@@ -46,6 +74,12 @@ struct TUPLES{
     }
 };
 
+/* Record of the weighted trace format: the 5-tuple followed by the packet length */
+struct PACKET{
+    TUPLES tuple;
+    uint16_t length;
+};
+
 bool operator == (const TUPLES& a, const TUPLES& b){
     return memcmp(a.data, b.data, sizeof(TUPLES)) == 0;
 }
@@ -60,6 +94,63 @@ namespace std{
     };
 }
 
+#define TUPLES6_LEN 37
+
+/* IPv6 5-tuple: srcIP(16) dstIP(16) srcPort(2) dstPort(2) proto(1) */
+struct TUPLES6{
+    uint8_t data[TUPLES6_LEN];
+
+    inline const uint8_t* srcIP() const{
+        return data;
+    }
+
+    inline const uint8_t* dstIP() const{
+        return &data[16];
+    }
+
+    inline uint16_t srcPort() const{
+        return *((uint16_t*)(&data[32]));
+    }
+
+    inline uint16_t dstPort() const{
+        return *((uint16_t*)(&data[34]));
+    }
+
+    inline uint8_t proto() const{
+        return *((uint8_t*)(&data[36]));
+    }
+
+    /* IPv4-mapped form (::ffff:a.b.c.d) of an IPv4 5-tuple */
+    static TUPLES6 FromV4(const TUPLES& tuple){
+        TUPLES6 ret;
+        memset(ret.data, 0, sizeof(ret.data));
+        ret.data[10] = ret.data[11] = 0xff;
+        ret.data[26] = ret.data[27] = 0xff;
+        memcpy(&ret.data[12], &tuple.data[0], 4);
+        memcpy(&ret.data[28], &tuple.data[4], 4);
+        memcpy(&ret.data[32], &tuple.data[8], 5);
+        return ret;
+    }
+};
+
+bool operator == (const TUPLES6& a, const TUPLES6& b){
+    return memcmp(a.data, b.data, sizeof(TUPLES6)) == 0;
+}
+
+namespace std{
+    template<>
+    struct hash<TUPLES6>{
+        size_t operator()(const TUPLES6& item) const noexcept
+        {
+            return Hash::BOBHash32((uint8_t*)&item, sizeof(TUPLES6), 0);
+        }
+    };
+}
+
+/* Narrower flow keys, taken from the front of TUPLES */
+typedef uint64_t SRC_DST;   /* srcIP_dstIP() */
+typedef uint32_t SRC_IP;    /* srcIP() */
+
 typedef int32_t COUNT_TYPE;   
 
 typedef std::chrono::high_resolution_clock::time_point TP;
@@ -72,10 +163,73 @@ inline double durationms(TP finish, TP start){
     return std::chrono::duration_cast<std::chrono::duration<double,std::ratio<1,1000000>>>(finish - start).count();
 }
 
+/* Start loading every cache line of object, to be read soon */
 template<typename T>
-T Median(std::vector<T> vec, uint32_t len){
-    std::sort(vec.begin(), vec.end());
-    return (len & 1) ? vec[len >> 1] : (vec[len >> 1] + vec[(len >> 1) - 1]) / 2.0;
+inline void Prefetch(const T* object){
+    uintptr_t end = (uintptr_t)object + sizeof(T);
+    for(uintptr_t line = (uintptr_t)object & ~(uintptr_t)63;line < end;line += 64)
+        __builtin_prefetch((const void*)line);
+}
+
+/* Bernoulli(p) trials up to and including the first success, in one draw */
+inline uint64_t GeometricTrials(double p, Random& random){
+    if(p >= 1)
+        return 1;
+    if(p <= 0)
+        return UINT64_MAX;
+    double trials = 1 + std::floor(std::log1p(-random.Uniform()) / std::log1p(-p));
+    return (trials < 1e18) ? (uint64_t)trials : UINT64_MAX;
+}
+
+/*
+ * Weighted form of the probabilistic decay used by the bucket sketches: each of
+ * weight units decrements counter with probability 1 / period(counter). Returns
+ * the units left for the new owner once counter reaches zero (the unit that
+ * empties it included), or 0 if the owner survives. A unit weight makes the
+ * single draw unit() of the original sketch; larger weights skip the failed
+ * trials geometrically, so the cost is one draw per decrement; a period of 1
+ * (certain decay) takes no draw at all. Draws come from the sketch's random.
+ */
+template<typename T, typename PERIOD, typename UNIT>
+inline T Decay(T& counter, T weight, PERIOD period, UNIT unit, Random& random){
+    if(weight == 1)
+        return (unit() && --counter <= 0) ? 1 : 0;
+
+    uint64_t remaining = weight;
+    while(remaining > 0){
+        double units = period(counter);
+        if(units <= 1){
+            if(remaining < (uint64_t)counter){
+                counter -= remaining;
+                return 0;
+            }
+            remaining -= counter;
+            counter = 0;
+            return remaining + 1;
+        }
+
+        uint64_t trials = GeometricTrials(1.0 / units, random);
+        if(trials > remaining)
+            return 0;
+        remaining -= trials;
+        if(--counter <= 0)
+            return remaining + 1;
+    }
+    return 0;
+}
+
+/* Median of N values, sorted in place by an odd-even transposition network */
+template<uint32_t N, typename T>
+T Median(T* values){
+    static_assert(N > 0, "Median of no values");
+    for(uint32_t round = 0;round < N;++round){
+        for(uint32_t i = round & 1;i + 1 < N;i += 2){
+            T low = std::min(values[i], values[i + 1]);
+            values[i + 1] = std::max(values[i], values[i + 1]);
+            values[i] = low;
+        }
+    }
+    return (N & 1) ? values[N >> 1] : (values[N >> 1] + values[(N >> 1) - 1]) / 2.0;
 }
 
 #endif
@@ -7,17 +7,46 @@
 #include <limits.h>
 #include <stdint.h>
 
+/*
+ * num picks one of the independent hash functions of a sketch; seed is the
+ * sketch's own seed, so two sketches with different seeds hash differently.
+ */
 template<typename T>
-inline uint32_t hash(const T& data, uint32_t seed = 0);
-inline uint32_t randomGenerator();
+inline uint32_t hash(const T& data, uint32_t num = 0, uint32_t seed = 0);
 
-static std::random_device rd;
-static std::mt19937 rng(rd());
-static std::uniform_real_distribution<double> dis(0, 1);
+/*
+ * Random stream owned by a sketch (splitmix64). Every random choice of a sketch
+ * comes from its own stream, so the same seed replays the same run.
+ */
+class Random{
+public:
+    Random(uint64_t seed = 0){
+        Seed(seed);
+    }
 
-inline uint32_t randomGenerator(){
-    return rng();
-}
+    inline void Seed(uint64_t seed){
+        state = seed;
+    }
+
+    inline uint32_t operator()(){
+        return Next() >> 32;
+    }
+
+    /* Uniform in [0, 1) */
+    inline double Uniform(){
+        return (Next() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+private:
+    uint64_t state;
+
+    inline uint64_t Next(){
+        uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+};
 
 #define MAX_PRIME 1229
 
@@ -139,12 +168,12 @@ static const uint32_t prime[] = {
 class Hash{
 public:
 
-    static uint32_t BOBHash32(const uint8_t* str, uint32_t len, uint32_t num){
+    static uint32_t BOBHash32(const uint8_t* str, uint32_t len, uint32_t num, uint32_t seed = 0){
         //register ub4 a,b,c,len;
         uint32_t a,b,c;
         /* Set up the internal state */
         a = b = 0x9e3779b9;  /* the golden ratio; an arbitrary value */
-        c = prime[num];         /* the previous hash value */
+        c = prime[num] ^ seed;  /* the previous hash value */
 
         /*---------------------------------------- handle most of the key */
         while (len >= 12)
@@ -179,10 +208,21 @@ public:
         return c;
     }
 
-    static uint64_t BOBHash64(const uint8_t* str, uint32_t len, uint32_t num){
+    /* 64-bit finalizer of MurmurHash3, for keys that fit in a machine word */
+    static uint32_t MixHash(uint64_t key, uint32_t num, uint32_t seed = 0){
+        key += (prime[num] ^ seed) * 0x9e3779b97f4a7c15ULL;
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdULL;
+        key ^= key >> 33;
+        key *= 0xc4ceb9fe1a85ec53ULL;
+        key ^= key >> 33;
+        return (uint32_t)key;
+    }
+
+    static uint64_t BOBHash64(const uint8_t* str, uint32_t len, uint32_t num, uint32_t seed = 0){
         uint64_t a,b,c;
         a = b = 0x9e3779b97f4a7c13LL;  /* the golden ratio; an arbitrary value */
-        c = prime[num];		 /* the previous hash value */
+        c = prime[num] ^ seed;   /* the previous hash value */
 
         /*---------------------------------------- handle most of the key */
 
@@ -235,8 +275,14 @@ public:
 };
 
 template<typename T>
-inline uint32_t hash(const T& data, uint32_t seed){
-    return Hash::BOBHash32((uint8_t*)&data, sizeof(T), seed);
+inline uint32_t hash(const T& data, uint32_t num, uint32_t seed){
+    return Hash::BOBHash32((uint8_t*)&data, sizeof(T), num, seed);
+}
+
+/* One 64-bit value for sketches that derive several indices from a single hash */
+template<typename T>
+inline uint64_t hash64(const T& data, uint32_t num = 0, uint32_t seed = 0){
+    return Hash::BOBHash64((uint8_t*)&data, sizeof(T), num, seed);
 }
 
 #endif
@@ -6,21 +6,83 @@
 #include <string.h>
 
 #include "Util.h"
+#include "Archive.h"
+
+/* Section tags of the snapshot format, one per class in Src/ */
+enum SketchKind : uint32_t{
+    KIND_COCOSKETCH = 1,
+    KIND_UNIVMON,
+    KIND_ELASTIC,
+    KIND_CMHEAP,
+    KIND_COUNTHEAP,
+    KIND_SPACESAVING,
+    KIND_MVSKETCH,
+    KIND_STABLESKETCH,
+    KIND_TWOSTAGE,
+    KIND_OURSKETCH,
+    KIND_ELASTICHEAVYPART,
+    KIND_HEAVYGUARDIAN,
+    KIND_TWOFASKETCH,
+    KIND_TIGHTSKETCH,
+    KIND_OURSKETCH2,
+    KIND_SLIDINGWINDOW,
+    KIND_SHAREDCOCOSKETCH,
+    KIND_CARDINALITY
+};
 
 template<typename DATA_TYPE>
 class Abstract{
 public:
     Abstract(){}
-    virtual ~Abstract(){};
+    virtual ~Abstract(){
+        if(snapshot.start != nullptr)
+            UnLoad(snapshot);
+    };
 
     std::string name;
     COUNT_TYPE stage1_bias;
+
+    static constexpr uint32_t PREFETCH_SLOTS = 32;
+
+    /* Hash seed and random stream; the same seed gives the same run */
+    uint32_t seed = 0;
+    Random random;
+
+    /* Set before the first Insert; composite sketches pass it to their parts */
+    virtual void Seed(uint32_t _seed){
+        seed = _seed;
+        random.Seed(_seed);
+    }
+
+    /* Set when the tables live in a mapped snapshot and must not be freed */
+    bool mapped = false;
+    LoadResult snapshot = {nullptr, 0};
     
     typedef std::unordered_map<DATA_TYPE, COUNT_TYPE> HashMap;
 
     virtual void Insert(const DATA_TYPE& item) = 0;
+    /* weight units of item at once, e.g. the packet length for byte counts */
+    virtual void Insert(const DATA_TYPE& item, COUNT_TYPE weight) = 0;
     virtual COUNT_TYPE Query(const DATA_TYPE& item) = 0;
+    /*
+     * Query of n keys into out. Sketches that read a few hashed slots per key
+     * override it to hash a group of keys, prefetch up to PREFETCH_SLOTS slots
+     * and only then read them, so the cache misses of a group overlap.
+     */
+    virtual void QueryBatch(const DATA_TYPE* keys, COUNT_TYPE* out, size_t n){
+        for(size_t i = 0;i < n;++i)
+            out[i] = Query(keys[i]);
+    }
     virtual HashMap AllQuery() = 0;
+    virtual void Clear() = 0;
+    virtual void Serialize(Archive& ar) = 0;
 };
 
+template<typename DATA_TYPE>
+constexpr uint32_t Abstract<DATA_TYPE>::PREFETCH_SLOTS;
+
+/* Creates an empty sketch of the given kind to be filled by Serialize, see Snapshot.h */
+template<typename DATA_TYPE>
+Abstract<DATA_TYPE>* NewSketch(uint32_t kind);
+
 #endif
@@ -0,0 +1,141 @@
+#ifndef AGGREGATOR_H
+#define AGGREGATOR_H
+
+#include "Abstract.h"
+
+/*
+ * Small set-associative table of key -> delta in front of a sketch. Repeated
+ * keys are summed in the table and reach the sketch as one weighted insert,
+ * when their way is evicted or every FLUSH_INTERVAL packets. A miss evicts the
+ * way with the smallest delta, so bursts of an elephant flow stay in the table.
+ * A 16-bit tag from the same hash screens the ways before the full key compare.
+ * Meant to be owned by one thread; several buffers may feed one sketch whose
+ * Insert is thread-safe, such as SharedCocoSketch.
+ * The sketch only sees buffered packets after Flush; the buffer does not own it.
+ */
+template<typename DATA_TYPE>
+class Aggregator{
+public:
+    static constexpr uint32_t WAYS = 8;
+
+    Aggregator(Abstract<DATA_TYPE>* _sketch, uint32_t _SETS = 64, uint64_t _FLUSH_INTERVAL = 4096){
+        if(_SETS == 0)
+            throw std::invalid_argument("Aggregator needs at least one set");
+
+        sketch = _sketch;
+        seed = sketch->seed;
+        SETS = _SETS;
+        FLUSH_INTERVAL = _FLUSH_INTERVAL;
+        name = "Aggregator ( " + sketch->name + " )";
+
+        ID = new DATA_TYPE[SETS * WAYS];
+        tag = new uint16_t[SETS * WAYS];
+        delta = new COUNT_TYPE[SETS * WAYS];
+        memset(delta, 0, sizeof(COUNT_TYPE) * SETS * WAYS);
+
+        packets = 0;
+        hits = 0;
+        updates = 0;
+    }
+
+    ~Aggregator(){
+        delete [] ID;
+        delete [] tag;
+        delete [] delta;
+    }
+
+    std::string name;
+
+    void Insert(const DATA_TYPE& item, COUNT_TYPE weight = 1){
+        uint32_t code = hash(item, HASH_SEED, seed);
+        uint32_t base = (code % SETS) * WAYS;
+        uint16_t fingerprint = code >> 16;
+        uint32_t victim = base;
+
+        packets += 1;
+        for(uint32_t i = base;i < base + WAYS;++i){
+            if(tag[i] == fingerprint && delta[i] != 0 && ID[i] == item){
+                delta[i] += weight;
+                hits += 1;
+                Tick();
+                return;
+            }
+            if(delta[i] < delta[victim])
+                victim = i;
+        }
+
+        if(delta[victim] != 0)
+            Evict(victim);
+        ID[victim] = item;
+        tag[victim] = fingerprint;
+        delta[victim] = weight;
+        Tick();
+    }
+
+    /* Hash seed of the sets and tags, by default the sketch's; set before the first Insert */
+    void Seed(uint32_t _seed){
+        seed = _seed;
+    }
+
+    /* Push every buffered delta into the sketch */
+    void Flush(){
+        for(uint32_t i = 0;i < SETS * WAYS;++i){
+            if(delta[i] != 0)
+                Evict(i);
+        }
+    }
+
+    /* Drop the buffered deltas and the counters without touching the sketch */
+    void Clear(){
+        memset(delta, 0, sizeof(COUNT_TYPE) * SETS * WAYS);
+        packets = 0;
+        hits = 0;
+        updates = 0;
+    }
+
+    /* Share of packets that found their key in the table */
+    inline double HitRatio() const{
+        return (packets == 0) ? 0 : (double)hits / packets;
+    }
+
+    /* Weighted inserts issued to the sketch per packet */
+    inline double UpdateRatio() const{
+        return (packets == 0) ? 0 : (double)updates / packets;
+    }
+
+private:
+    /* Hash function index, clear of the rows of the sketches behind the buffer */
+    static constexpr uint32_t HASH_SEED = 1023;
+
+    uint32_t seed;
+    uint32_t SETS;
+    uint64_t FLUSH_INTERVAL;
+
+    Abstract<DATA_TYPE>* sketch;
+
+    DATA_TYPE* ID;
+    uint16_t* tag;
+    COUNT_TYPE* delta;
+
+    uint64_t packets;
+    uint64_t hits;
+    uint64_t updates;
+
+    inline void Evict(uint32_t pos){
+        sketch->Insert(ID[pos], delta[pos]);
+        delta[pos] = 0;
+        updates += 1;
+    }
+
+    inline void Tick(){
+        if(FLUSH_INTERVAL != 0 && packets % FLUSH_INTERVAL == 0)
+            Flush();
+    }
+};
+
+template<typename DATA_TYPE>
+constexpr uint32_t Aggregator<DATA_TYPE>::WAYS;
+template<typename DATA_TYPE>
+constexpr uint32_t Aggregator<DATA_TYPE>::HASH_SEED;
+
+#endif
@@ -4,7 +4,11 @@
 #include "CMSketch.h"
 #include "Heap.h"
 
-template<typename DATA_TYPE>
+/*
+ * SLOT_TYPE and HASH_NUM set the width and the number of rows of the light part;
+ * CONSERVATIVE makes it update conservatively.
+ */
+template<typename DATA_TYPE, typename SLOT_TYPE = COUNT_TYPE, uint32_t HASH_NUM = 4, bool CONSERVATIVE = false>
 class CMHeap : public Abstract<DATA_TYPE>{
 public:
     typedef std::unordered_map<DATA_TYPE, COUNT_TYPE> HashMap;
@@ -15,19 +19,23 @@ public:
         uint32_t LIGHT_MEMORY = _MEMORY * LIGHT_RATIO;
         uint32_t HEAVY_MEMORY = _MEMORY * HEAVY_RATIO;
 
-        sketch = new CMSketch<DATA_TYPE, COUNT_TYPE>(LIGHT_MEMORY);
+        sketch = new CMSketch<DATA_TYPE, COUNT_TYPE, SLOT_TYPE, HASH_NUM, CONSERVATIVE>(LIGHT_MEMORY);
         heap = new Heap<DATA_TYPE, COUNT_TYPE>(heap->Memory2Size(HEAVY_MEMORY));
     }
 
+    CMHeap(){}
+
     ~CMHeap(){
         delete sketch;
         delete heap;
     }
 
     void Insert(const DATA_TYPE& item) {
-        sketch->Insert(item);
-        COUNT_TYPE est = sketch->Query(item);
-        heap->Insert(item, est);
+        Insert(item, 1);
+    }
+
+    void Insert(const DATA_TYPE& item, COUNT_TYPE weight) {
+        heap->Insert(item, sketch->InsertAndQuery(item, weight), weight);
     }
 
     COUNT_TYPE Query(const DATA_TYPE& item){
@@ -41,13 +49,48 @@ public:
         return heap->AllQuery();
     }
 
+    void Seed(uint32_t _seed){
+        Abstract<DATA_TYPE>::Seed(_seed);
+        sketch->Seed(_seed);
+    }
+
+    void Clear(){
+        sketch->Clear();
+        heap->Clear();
+    }
+
+    /* Narrow counters that escalated into a side counter another slot holds */
+    inline uint32_t Shared() const{
+        return sketch->Shared();
+    }
+
+    void Serialize(Archive& ar){
+        ar.Section(KIND_CMHEAP);
+        ar.String(this->name);
+        ar.Value(this->seed);
+        ar.Param(HEAVY_RATIO);
+        ar.Param(LIGHT_RATIO);
+
+        if(ar.Loading()){
+            sketch = new CMSketch<DATA_TYPE, COUNT_TYPE, SLOT_TYPE, HASH_NUM, CONSERVATIVE>();
+            heap = new Heap<DATA_TYPE, COUNT_TYPE>();
+        }
+        sketch->Serialize(ar);
+        heap->Serialize(ar);
+    }
+
 private:
 
-    const double HEAVY_RATIO = 0.25;
-    const double LIGHT_RATIO = 0.75;
+    static constexpr double HEAVY_RATIO = 0.25;
+    static constexpr double LIGHT_RATIO = 0.75;
 
-    CMSketch<DATA_TYPE, COUNT_TYPE>* sketch;
-    Heap<DATA_TYPE, COUNT_TYPE>* heap;
+    CMSketch<DATA_TYPE, COUNT_TYPE, SLOT_TYPE, HASH_NUM, CONSERVATIVE>* sketch = nullptr;
+    Heap<DATA_TYPE, COUNT_TYPE>* heap = nullptr;
 };
 
+template<typename DATA_TYPE, typename SLOT_TYPE, uint32_t HASH_NUM, bool CONSERVATIVE>
+constexpr double CMHeap<DATA_TYPE, SLOT_TYPE, HASH_NUM, CONSERVATIVE>::HEAVY_RATIO;
+template<typename DATA_TYPE, typename SLOT_TYPE, uint32_t HASH_NUM, bool CONSERVATIVE>
+constexpr double CMHeap<DATA_TYPE, SLOT_TYPE, HASH_NUM, CONSERVATIVE>::LIGHT_RATIO;
+
 #endif
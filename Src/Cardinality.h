@@ -0,0 +1,97 @@
+#ifndef CARDINALITY_H
+#define CARDINALITY_H
+
+#include "Abstract.h"
+#include "HyperLogLog.h"
+
+/*
+ * Any sketch plus a HyperLogLog of the distinct keys it has been given, for
+ * one more hash and one register update per packet. Takes ownership of the
+ * sketch; the estimator's memory comes on top of it. A sketch that already
+ * computes a 64-bit hash per packet can feed a HyperLogLog itself instead, as
+ * UnivMon does.
+ */
+template<typename DATA_TYPE>
+class Cardinality : public Abstract<DATA_TYPE>{
+public:
+    typedef std::unordered_map<DATA_TYPE, COUNT_TYPE> HashMap;
+
+    Cardinality(Abstract<DATA_TYPE>* _sketch, uint32_t _DISTINCT_MEMORY = 4096){
+        sketch = _sketch;
+        counter = new HyperLogLog(_DISTINCT_MEMORY);
+        this->name = sketch->name + " + HyperLogLog";
+    }
+
+    Cardinality(){}
+
+    ~Cardinality(){
+        delete sketch;
+        delete counter;
+    }
+
+    void Insert(const DATA_TYPE& item){
+        Insert(item, 1);
+    }
+
+    void Insert(const DATA_TYPE& item, COUNT_TYPE weight){
+        sketch->Insert(item, weight);
+        counter->Insert(hash64(item, HASH_SEED, this->seed));
+    }
+
+    COUNT_TYPE Query(const DATA_TYPE& item){
+        return sketch->Query(item);
+    }
+
+    void QueryBatch(const DATA_TYPE* keys, COUNT_TYPE* out, size_t n){
+        sketch->QueryBatch(keys, out, n);
+    }
+
+    HashMap AllQuery(){
+        return sketch->AllQuery();
+    }
+
+    /* Estimated number of distinct keys inserted since the last Clear */
+    inline double Distinct() const{
+        return counter->Estimate();
+    }
+
+    /* Add the keys of another estimator with the same seed, e.g. another link or thread */
+    void Merge(const Cardinality& other){
+        counter->Merge(*other.counter);
+    }
+
+    void Seed(uint32_t _seed){
+        Abstract<DATA_TYPE>::Seed(_seed);
+        sketch->Seed(_seed);
+    }
+
+    void Clear(){
+        sketch->Clear();
+        counter->Clear();
+    }
+
+    void Serialize(Archive& ar){
+        ar.Section(KIND_CARDINALITY);
+        ar.String(this->name);
+        ar.Value(this->seed);
+
+        if(ar.Loading())
+            counter = new HyperLogLog();
+        counter->Serialize(ar);
+
+        if(ar.Loading())
+            sketch = NewSketch<DATA_TYPE>(ar.Peek());
+        sketch->Serialize(ar);
+    }
+
+private:
+    static constexpr uint32_t HASH_SEED = 307;
+
+    Abstract<DATA_TYPE>* sketch = nullptr;
+    HyperLogLog* counter = nullptr;
+};
+
+template<typename DATA_TYPE>
+constexpr uint32_t Cardinality<DATA_TYPE>::HASH_SEED;
+
+#endif
@@ -11,6 +11,11 @@ public:
     struct Counter{
         DATA_TYPE ID;
         COUNT_TYPE count;
+
+        void Code(Archive& ar){
+            ar.Key(ID);
+            ar.Count(count);
+        }
     };
 
     typedef std::unordered_map<DATA_TYPE, COUNT_TYPE> HashMap;
@@ -29,21 +34,30 @@ public:
         }
     }
 
+    CocoSketch(){}
+
     ~CocoSketch(){
-        for(uint32_t i = 0;i < HASH_NUM;++i){
-            delete [] counter[i];
+        if(!this->mapped && counter != nullptr){
+            for(uint32_t i = 0;i < HASH_NUM;++i){
+                delete [] counter[i];
+            }
         }
         delete [] counter;
     }
 
     void Insert(const DATA_TYPE& item){
+        Insert(item, 1);
+    }
+
+    /* Weighted as in the CocoSketch paper: the new key takes over with probability weight / count */
+    void Insert(const DATA_TYPE& item, COUNT_TYPE weight){
         COUNT_TYPE minimum = std::numeric_limits<COUNT_TYPE>::max();
-        uint32_t minPos, minHash;
+        uint32_t minPos = 0, minHash = 0;
 
         for(uint32_t i = 0;i < HASH_NUM;++i){
-            uint32_t position = hash(item, i) % LENGTH;
+            uint32_t position = hash(item, i, this->seed) % LENGTH;
             if(counter[i][position].ID == item){
-                counter[i][position].count += 1;
+                counter[i][position].count += weight;
                 return;
             }
             if(counter[i][position].count < minimum){
@@ -53,15 +67,15 @@ public:
             }
         }
 
-        counter[minHash][minPos].count += 1;
-        if(randomGenerator() % counter[minHash][minPos].count == 0){
+        counter[minHash][minPos].count += weight;
+        if(this->random() % counter[minHash][minPos].count < (uint32_t)weight){
             counter[minHash][minPos].ID = item;
         }
     }
 
     COUNT_TYPE Query(const DATA_TYPE& item){
         for(uint32_t i = 0; i < HASH_NUM; ++i) {
-            uint32_t position = hash(item, i) % LENGTH;
+            uint32_t position = hash(item, i, this->seed) % LENGTH;
             if(counter[i][position].ID == item){
                 return counter[i][position].count + this->stage1_bias;
             }
@@ -69,23 +83,79 @@ public:
         return 0;
     }
 
+    /*
+     * A group goes row by row, prefetching only for the keys not found yet,
+     * so no key hashes more rows than in Query
+     */
+    void QueryBatch(const DATA_TYPE* keys, COUNT_TYPE* out, size_t n){
+        constexpr uint32_t GROUP = Abstract<DATA_TYPE>::PREFETCH_SLOTS;
+        uint32_t pending[GROUP], positions[GROUP];
+
+        for(size_t begin = 0;begin < n;begin += GROUP){
+            uint32_t size = std::min<size_t>(GROUP, n - begin);
+            for(uint32_t k = 0;k < size;++k){
+                pending[k] = k;
+                out[begin + k] = 0;
+            }
+            for(uint32_t i = 0;i < HASH_NUM && size > 0;++i){
+                HashBatch(keys + begin, pending, size, i, this->seed, positions);
+                for(uint32_t k = 0;k < size;++k){
+                    positions[k] %= LENGTH;
+                    Prefetch(&counter[i][positions[k]]);
+                }
+                uint32_t left = 0;
+                for(uint32_t k = 0;k < size;++k){
+                    if(counter[i][positions[k]].ID == keys[begin + pending[k]])
+                        out[begin + pending[k]] = counter[i][positions[k]].count + this->stage1_bias;
+                    else
+                        pending[left++] = pending[k];
+                }
+                size = left;
+            }
+        }
+    }
+
     HashMap AllQuery(){
         HashMap ret;
 
         for(uint32_t i = 0;i < HASH_NUM;++i){
             for(uint32_t j = 0;j < LENGTH;++j){
-                ret[counter[i][j].ID] = counter[i][j].count + this->stage1_bias;
+                if(counter[i][j].count != 0)
+                    ret[counter[i][j].ID] = counter[i][j].count + this->stage1_bias;
             }
         }
 
         return ret;
     }
 
+    void Clear(){
+        for(uint32_t i = 0;i < HASH_NUM;++i){
+            memset(counter[i], 0, sizeof(Counter) * LENGTH);
+        }
+    }
+
+    void Serialize(Archive& ar){
+        ar.Section(KIND_COCOSKETCH);
+        ar.Attach(this->mapped);
+        ar.String(this->name);
+        ar.Value(this->stage1_bias);
+        ar.Value(this->seed);
+        ar.Value(this->random);
+        ar.Value(HASH_NUM);
+        ar.Value(LENGTH);
+
+        if(ar.Loading())
+            counter = new Counter* [HASH_NUM]();
+        for(uint32_t i = 0;i < HASH_NUM;++i){
+            ar.Array(counter[i], LENGTH);
+        }
+    }
+
 private:
     uint32_t LENGTH;
     uint32_t HASH_NUM;
 
-    Counter** counter;
+    Counter** counter = nullptr;
 };
 
 #endif
\ No newline at end of file
@@ -4,7 +4,8 @@
 #include "CSketch.h"
 #include "Heap.h"
 
-template<typename DATA_TYPE>
+/* SLOT_TYPE and HASH_NUM set the width and the number of rows of the light part */
+template<typename DATA_TYPE, typename SLOT_TYPE = COUNT_TYPE, uint32_t HASH_NUM = 3>
 class CountHeap : public Abstract<DATA_TYPE>{
 public:
     typedef std::unordered_map<DATA_TYPE, COUNT_TYPE> HashMap;
@@ -15,19 +16,23 @@ public:
         uint32_t LIGHT_MEMORY = _MEMORY * LIGHT_RATIO;
         uint32_t HEAVY_MEMORY = _MEMORY * HEAVY_RATIO;
 
-        sketch = new CSketch<DATA_TYPE, COUNT_TYPE>(LIGHT_MEMORY);
+        sketch = new CSketch<DATA_TYPE, COUNT_TYPE, SLOT_TYPE, HASH_NUM>(LIGHT_MEMORY);
         heap = new Heap<DATA_TYPE, COUNT_TYPE>(heap->Memory2Size(HEAVY_MEMORY));
     }
 
+    CountHeap(){}
+
     ~CountHeap(){
         delete sketch;
         delete heap;
     }
 
     void Insert(const DATA_TYPE& item) {
-        sketch->Insert(item);
-        COUNT_TYPE est = sketch->Query(item);
-        heap->Insert(item, est);
+        Insert(item, 1);
+    }
+
+    void Insert(const DATA_TYPE& item, COUNT_TYPE weight) {
+        heap->Insert(item, sketch->InsertAndQuery(item, weight), weight);
     }
 
     COUNT_TYPE Query(const DATA_TYPE& item){
@@ -41,14 +46,49 @@ public:
         return heap->AllQuery();
     }
 
+    void Seed(uint32_t _seed){
+        Abstract<DATA_TYPE>::Seed(_seed);
+        sketch->Seed(_seed);
+    }
+
+    void Clear(){
+        sketch->Clear();
+        heap->Clear();
+    }
+
+    /* Narrow counters that escalated into a side counter another slot holds */
+    inline uint32_t Shared() const{
+        return sketch->Shared();
+    }
+
+    void Serialize(Archive& ar){
+        ar.Section(KIND_COUNTHEAP);
+        ar.String(this->name);
+        ar.Value(this->seed);
+        ar.Param(HEAVY_RATIO);
+        ar.Param(LIGHT_RATIO);
+
+        if(ar.Loading()){
+            sketch = new CSketch<DATA_TYPE, COUNT_TYPE, SLOT_TYPE, HASH_NUM>();
+            heap = new Heap<DATA_TYPE, COUNT_TYPE>();
+        }
+        sketch->Serialize(ar);
+        heap->Serialize(ar);
+    }
+
 private:
 
-    const double HEAVY_RATIO = 0.25;
-    const double LIGHT_RATIO = 0.75;
+    static constexpr double HEAVY_RATIO = 0.25;
+    static constexpr double LIGHT_RATIO = 0.75;
 
-    CSketch<DATA_TYPE, COUNT_TYPE>* sketch;
-    Heap<DATA_TYPE, COUNT_TYPE>* heap;
+    CSketch<DATA_TYPE, COUNT_TYPE, SLOT_TYPE, HASH_NUM>* sketch = nullptr;
+    Heap<DATA_TYPE, COUNT_TYPE>* heap = nullptr;
 };
 
 
+template<typename DATA_TYPE, typename SLOT_TYPE, uint32_t HASH_NUM>
+constexpr double CountHeap<DATA_TYPE, SLOT_TYPE, HASH_NUM>::HEAVY_RATIO;
+template<typename DATA_TYPE, typename SLOT_TYPE, uint32_t HASH_NUM>
+constexpr double CountHeap<DATA_TYPE, SLOT_TYPE, HASH_NUM>::LIGHT_RATIO;
+
 #endif
@@ -2,13 +2,18 @@
 #define ELASTIC_H
 
 #include "Abstract.h"
+#include "MRAC.h"
 #include <limits> 
 
-template<typename DATA_TYPE>
+/*
+ * LIGHT_TYPE sets the width of the light part counters, which saturate at its maximum.
+ * COUNTER_PER_BUCKET flows share a heavy bucket; one is evicted once the
+ * negative votes reach LAMBDA times its count.
+ */
+template<typename DATA_TYPE, typename LIGHT_TYPE = COUNT_TYPE, uint32_t COUNTER_PER_BUCKET = 4, uint32_t LAMBDA = 8>
 class Elastic : public Abstract<DATA_TYPE> {
 public:
     typedef std::unordered_map<DATA_TYPE, COUNT_TYPE> HashMap;
-    static constexpr uint32_t COUNTER_PER_BUCKET = 4;
 
     struct Bucket{
         COUNT_TYPE vote;
@@ -25,6 +30,15 @@ public:
             }
             return 0;
         }
+
+        void Code(Archive& ar) {
+            ar.Count(vote);
+            for(uint32_t i = 0; i < COUNTER_PER_BUCKET; i++) {
+                ar.Count(flags[i]);
+                ar.Key(ID[i]);
+                ar.Count(count[i]);
+            }
+        }
     };
 
     Elastic(uint32_t _MEMORY, uint32_t _STAGE1_BIAS = 0, std::string _name = "Elastic"){
@@ -32,33 +46,41 @@ public:
 
         this->stage1_bias = _STAGE1_BIAS;
         HEAVY_LENGTH = _MEMORY * HEAVY_RATIO / sizeof(Bucket);
-        LIGHT_LENGTH = _MEMORY * LIGHT_RATIO / sizeof(COUNT_TYPE);
+        LIGHT_LENGTH = _MEMORY * LIGHT_RATIO / sizeof(LIGHT_TYPE);
 
         buckets = new Bucket[HEAVY_LENGTH];
-        counters = new COUNT_TYPE[LIGHT_LENGTH];
+        counters = new LIGHT_TYPE[LIGHT_LENGTH];
 
         memset(buckets, 0, sizeof(Bucket) * HEAVY_LENGTH);
-        memset(counters, 0, sizeof(COUNT_TYPE) * LIGHT_LENGTH);
+        memset(counters, 0, sizeof(LIGHT_TYPE) * LIGHT_LENGTH);
     }
 
+    Elastic(){}
+
     ~Elastic(){
-        delete [] counters;
-        delete [] buckets;
+        if(!this->mapped){
+            delete [] counters;
+            delete [] buckets;
+        }
     }
 
     void Insert(const DATA_TYPE& item) {
-        uint32_t pos = hash(item) % HEAVY_LENGTH, minPos = 0;
+        Insert(item, 1);
+    }
+
+    void Insert(const DATA_TYPE& item, COUNT_TYPE weight) {
+        uint32_t pos = hash(item, 0, this->seed) % HEAVY_LENGTH, minPos = 0;
         COUNT_TYPE minVal = std::numeric_limits<COUNT_TYPE>::max();
 
         for (uint32_t i = 0; i < COUNTER_PER_BUCKET; i++){
             if(buckets[pos].ID[i] == item){
-                buckets[pos].count[i] += 1;
+                buckets[pos].count[i] += weight;
                 return;
             }
 
             if(buckets[pos].count[i] == 0){
                 buckets[pos].ID[i] = item;
-                buckets[pos].count[i] = 1;
+                buckets[pos].count[i] = weight;
                 return;
             }
 
@@ -68,37 +90,69 @@ public:
             }
         }
 
-        if((buckets[pos].vote + 1) >= minVal * LAMBDA){
+        if((buckets[pos].vote + weight) >= (int64_t)minVal * LAMBDA){
             buckets[pos].vote = 0;
             buckets[pos].flags[minPos] = 1;
 
             Light_Insert(buckets[pos].ID[minPos], buckets[pos].count[minPos]);
 
             buckets[pos].ID[minPos] = item;
-            buckets[pos].count[minPos] = 1;
+            buckets[pos].count[minPos] = weight;
         }
         else {
-            buckets[pos].vote += 1;
-            Light_Insert(item);
+            buckets[pos].vote += weight;
+            Light_Insert(item, weight);
         }
     }
 
     COUNT_TYPE Query(const DATA_TYPE& item){
         uint8_t flag = 1;
-        COUNT_TYPE result = buckets[hash(item) % HEAVY_LENGTH].Query(item, flag);
+        COUNT_TYPE result = buckets[hash(item, 0, this->seed) % HEAVY_LENGTH].Query(item, flag);
         if(flag)
-            return result + counters[hash(item, 101) % LIGHT_LENGTH] + this->stage1_bias;
+            return result + counters[hash(item, 101, this->seed) % LIGHT_LENGTH] + this->stage1_bias;
         else
             return result + this->stage1_bias;
     }
 
+    /* The heavy buckets of a group first, then the light counters of the keys that need them */
+    void QueryBatch(const DATA_TYPE* keys, COUNT_TYPE* out, size_t n){
+        constexpr uint32_t GROUP = Abstract<DATA_TYPE>::PREFETCH_SLOTS;
+        uint32_t pending[GROUP], positions[GROUP];
+
+        for(size_t begin = 0;begin < n;begin += GROUP){
+            uint32_t size = std::min<size_t>(GROUP, n - begin);
+            HashBatch(keys + begin, (const uint32_t*)nullptr, size, 0, this->seed, positions);
+            for(uint32_t k = 0;k < size;++k){
+                positions[k] %= HEAVY_LENGTH;
+                Prefetch(&buckets[positions[k]]);
+            }
+            uint32_t left = 0;
+            for(uint32_t k = 0;k < size;++k){
+                uint8_t flag = 1;
+                out[begin + k] = buckets[positions[k]].Query(keys[begin + k], flag) + this->stage1_bias;
+                if(flag)
+                    pending[left++] = k;
+            }
+
+            HashBatch(keys + begin, pending, left, 101, this->seed, positions);
+            for(uint32_t k = 0;k < left;++k){
+                positions[k] %= LIGHT_LENGTH;
+                Prefetch(&counters[positions[k]]);
+            }
+            for(uint32_t k = 0;k < left;++k)
+                out[begin + pending[k]] += counters[positions[k]];
+        }
+    }
+
     HashMap AllQuery(){
         HashMap ret;
         for(uint32_t i = 0;i < HEAVY_LENGTH;++i){
             for(uint32_t j = 0;j < COUNTER_PER_BUCKET;++j){
+                if(buckets[i].count[j] == 0)
+                    continue;
                 if(buckets[i].flags[j] == 1){
                     ret[buckets[i].ID[j]] = buckets[i].count[j] +
-                    counters[hash(buckets[i].ID[j], 101) % LIGHT_LENGTH] + 
+                    counters[hash(buckets[i].ID[j], 101, this->seed) % LIGHT_LENGTH] + 
                     this->stage1_bias;
                 }
                 else{
@@ -109,25 +163,80 @@ public:
         return ret;
     }
 
-private:
+    /*
+     * Flows of each size, indexed by size: the light part through solver, plus
+     * the heavy flows at their queried size (without the stage-1 bias). An evicted flow's light share is
+     * also counted once as a light flow, as in the Elastic paper.
+     */
+    std::vector<double> Distribution(MRAC& solver){
+        std::vector<uint64_t> histogram;
+        for(uint32_t i = 0;i < LIGHT_LENGTH;++i){
+            if((uint64_t)counters[i] >= histogram.size())
+                histogram.resize((uint64_t)counters[i] + 1);
+            histogram[counters[i]] += 1;
+        }
 
-    const double HEAVY_RATIO = 0.25;
-    const double LIGHT_RATIO = 0.75;
+        std::vector<double> ret = solver.Estimate(histogram);
+        for(uint32_t i = 0;i < HEAVY_LENGTH;++i){
+            for(uint32_t j = 0;j < COUNTER_PER_BUCKET;++j){
+                if(buckets[i].count[j] == 0)
+                    continue;
+                uint64_t size = buckets[i].count[j];
+                if(buckets[i].flags[j] == 1)
+                    size += counters[hash(buckets[i].ID[j], 101, this->seed) % LIGHT_LENGTH];
+                if(size >= ret.size())
+                    ret.resize(size + 1);
+                ret[size] += 1;
+            }
+        }
+        return ret;
+    }
 
-    const uint32_t LAMBDA = 8;
+    void Clear(){
+        memset(buckets, 0, sizeof(Bucket) * HEAVY_LENGTH);
+        memset(counters, 0, sizeof(LIGHT_TYPE) * LIGHT_LENGTH);
+    }
+
+    void Serialize(Archive& ar){
+        ar.Section(KIND_ELASTIC);
+        ar.Attach(this->mapped);
+        ar.String(this->name);
+        ar.Param(COUNTER_PER_BUCKET);
+        ar.Param(HEAVY_RATIO);
+        ar.Param(LIGHT_RATIO);
+        ar.Param(LAMBDA);
+        ar.Param((uint32_t)sizeof(LIGHT_TYPE));
+        ar.Value(this->stage1_bias);
+        ar.Value(this->seed);
+        ar.Value(this->random);
+        ar.Value(HEAVY_LENGTH);
+        ar.Value(LIGHT_LENGTH);
+        ar.Array(buckets, HEAVY_LENGTH);
+        ar.Array(counters, LIGHT_LENGTH);
+    }
+
+private:
+
+    static constexpr double HEAVY_RATIO = 0.25;
+    static constexpr double LIGHT_RATIO = 0.75;
 
     uint32_t LIGHT_LENGTH;
     uint32_t HEAVY_LENGTH;
 
-    COUNT_TYPE* counters;
-    Bucket* buckets;
+    LIGHT_TYPE* counters = nullptr;
+    Bucket* buckets = nullptr;
 
     void Light_Insert(const DATA_TYPE item, COUNT_TYPE val = 1) {
-        uint32_t position = hash(item, 101) % LIGHT_LENGTH;
-        COUNT_TYPE new_val = counters[position] + val;
-        COUNT_TYPE MAXNUM = std::numeric_limits<COUNT_TYPE>::max();
+        uint32_t position = hash(item, 101, this->seed) % LIGHT_LENGTH;
+        int64_t new_val = (int64_t)counters[position] + val;
+        int64_t MAXNUM = std::numeric_limits<LIGHT_TYPE>::max();
         counters[position] = (new_val > MAXNUM ? MAXNUM : new_val);
     }
 };
 
+template<typename DATA_TYPE, typename LIGHT_TYPE, uint32_t COUNTER_PER_BUCKET, uint32_t LAMBDA>
+constexpr double Elastic<DATA_TYPE, LIGHT_TYPE, COUNTER_PER_BUCKET, LAMBDA>::HEAVY_RATIO;
+template<typename DATA_TYPE, typename LIGHT_TYPE, uint32_t COUNTER_PER_BUCKET, uint32_t LAMBDA>
+constexpr double Elastic<DATA_TYPE, LIGHT_TYPE, COUNTER_PER_BUCKET, LAMBDA>::LIGHT_RATIO;
+
 #endif
\ No newline at end of file
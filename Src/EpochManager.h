@@ -0,0 +1,163 @@
+#ifndef EPOCHMANAGER_H
+#define EPOCHMANAGER_H
+
+#include "Abstract.h"
+
+/*
+ * Double-buffered epochs: the ingestion thread writes into the active sketch
+ * while a background thread reports and clears the retired one. At an epoch
+ * boundary the ingestion thread only swaps pointers; if the retired sketch is
+ * not cleared yet, the current epoch is extended instead of waiting. The last,
+ * partial epoch is reported from the destructor, on the destroying thread.
+ */
+template<typename DATA_TYPE>
+class EpochManager : public Abstract<DATA_TYPE>{
+public:
+    typedef std::unordered_map<DATA_TYPE, COUNT_TYPE> HashMap;
+    typedef std::function<Abstract<DATA_TYPE>*(uint32_t)> Factory;
+    typedef std::function<void(uint64_t, uint64_t, const HashMap&)> Reporter;
+
+    EpochManager(uint32_t _MEMORY, uint64_t _EPOCH_LENGTH, Factory factory, Reporter _reporter,
+                 std::string _name = "EpochManager"){
+        EPOCH_LENGTH = _EPOCH_LENGTH;
+        reporter = _reporter;
+
+        active = factory(_MEMORY);
+        standby.store(factory(_MEMORY));
+        retired.store(nullptr);
+
+        this->name = _name + " ( " + active->name + " )";
+
+        epoch = 0;
+        packets = 0;
+        delayed = 0;
+        retiredEpoch = 0;
+        retiredPackets = 0;
+
+        stop.store(false);
+        worker = std::thread(&EpochManager::Drain, this);
+    }
+
+    /* Reports any retired epoch still pending, then the partial active one */
+    ~EpochManager(){
+        stop.store(true);
+        wakeup.notify_one();
+        worker.join();
+
+        /* Retired after the worker's last look at it, before stop was set */
+        if(Abstract<DATA_TYPE>* sketch = retired.exchange(nullptr, std::memory_order_acquire)){
+            reporter(retiredEpoch, retiredPackets, sketch->AllQuery());
+            delete sketch;
+        }
+        if(packets > 0)
+            reporter(epoch, packets, active->AllQuery());
+
+        delete active;
+        delete standby.load();
+    }
+
+    void Insert(const DATA_TYPE& item){
+        Insert(item, 1);
+    }
+
+    void Insert(const DATA_TYPE& item, COUNT_TYPE weight){
+        if(EPOCH_LENGTH != 0 && packets >= EPOCH_LENGTH)
+            Rotate();
+        active->Insert(item, weight);
+        packets += 1;
+    }
+
+    /* Swap in the cleared sketch; returns false (and keeps the epoch open) if it is not ready yet */
+    bool Rotate(){
+        Abstract<DATA_TYPE>* fresh = standby.exchange(nullptr, std::memory_order_acquire);
+        if(fresh == nullptr){
+            delayed += 1;
+            return false;
+        }
+
+        retiredEpoch = epoch;
+        retiredPackets = packets;
+        retired.store(active, std::memory_order_release);
+        wakeup.notify_one();
+
+        active = fresh;
+        epoch += 1;
+        packets = 0;
+        return true;
+    }
+
+    COUNT_TYPE Query(const DATA_TYPE& item){
+        return active->Query(item);
+    }
+
+    HashMap AllQuery(){
+        return active->AllQuery();
+    }
+
+    void Seed(uint32_t _seed){
+        Abstract<DATA_TYPE>::Seed(_seed);
+        active->Seed(_seed);
+        standby.load()->Seed(_seed);
+    }
+
+    void Clear(){
+        active->Clear();
+        packets = 0;
+    }
+
+    /* Only the active epoch is stored; it loads back as the wrapped sketch kind */
+    void Serialize(Archive& ar){
+        active->Serialize(ar);
+    }
+
+    inline uint64_t Epoch(){
+        return epoch;
+    }
+
+    /* Number of boundary checks that found the retired sketch still draining */
+    inline uint64_t Delayed(){
+        return delayed;
+    }
+
+private:
+    uint64_t EPOCH_LENGTH;
+    Reporter reporter;
+
+    Abstract<DATA_TYPE>* active;
+    std::atomic<Abstract<DATA_TYPE>*> standby;
+    std::atomic<Abstract<DATA_TYPE>*> retired;
+
+    uint64_t epoch;
+    uint64_t packets;
+    uint64_t delayed;
+
+    /* Written before retired is published, read by the worker after it is taken */
+    uint64_t retiredEpoch;
+    uint64_t retiredPackets;
+
+    std::atomic<bool> stop;
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::thread worker;
+
+    void Drain(){
+        while(true){
+            Abstract<DATA_TYPE>* sketch = retired.exchange(nullptr, std::memory_order_acquire);
+
+            if(sketch == nullptr){
+                if(stop.load())
+                    break;
+                /* The ingestion side notifies without locking, so a timed wait covers a lost wakeup */
+                std::unique_lock<std::mutex> lock(mutex);
+                wakeup.wait_for(lock, std::chrono::milliseconds(1));
+                continue;
+            }
+
+            reporter(retiredEpoch, retiredPackets, sketch->AllQuery());
+            sketch->Clear();
+            standby.store(sketch, std::memory_order_release);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,253 @@
+#ifndef HHH_H
+#define HHH_H
+
+#include "Abstract.h"
+
+/*
+ * Hierarchical heavy hitters over srcIP prefixes. Each prefix length has a
+ * table of buckets of masked srcIPs (host byte order, low bits zeroed), with
+ * HeavyGuardian's exponential decay among the slots of a bucket.
+ *   ALL_LEVELS: every packet updates every level. One hash of the srcIP,
+ *               chained through its prefixes from the shortest, gives every
+ *               level's bucket; the buckets are all prefetched before any is
+ *               updated, so the levels' cache misses overlap.
+ *   SAMPLED:    every packet updates one random level and the estimates are
+ *               scaled by the number of levels (RHHH), so the per-packet cost
+ *               does not grow with the hierarchy.
+ * Memory goes to the shortest prefixes first, up to one slot per possible
+ * prefix, which makes those levels exact; the rest is shared evenly.
+ */
+class HHH{
+public:
+    typedef std::unordered_map<SRC_IP, COUNT_TYPE> HashMap;
+
+    enum Mode{
+        ALL_LEVELS,
+        SAMPLED
+    };
+
+    struct Prefix{
+        SRC_IP prefix;
+        uint32_t length;
+        COUNT_TYPE count;
+        COUNT_TYPE conditioned;
+    };
+
+    static constexpr uint32_t MAX_LEVEL = 33;
+    static constexpr uint32_t COUNTER_PER_BUCKET = 4;
+    static constexpr double DECAY = 1.08;
+
+    struct Bucket{
+        SRC_IP ID[COUNTER_PER_BUCKET];
+        COUNT_TYPE count[COUNTER_PER_BUCKET];
+    };
+
+    /* Prefix lengths 32, 32 - GRANULARITY, ..., 0 */
+    HHH(uint32_t _MEMORY, uint32_t _GRANULARITY, Mode _mode = ALL_LEVELS){
+        if(_GRANULARITY == 0 || _GRANULARITY > 32)
+            throw std::invalid_argument("HHH granularity must be between 1 and 32 bits");
+
+        mode = _mode;
+        LEVEL = 0;
+        for(int32_t length = 32;length > -(int32_t)_GRANULARITY;length -= _GRANULARITY){
+            lengths[LEVEL] = std::max(length, 0);
+            masks[LEVEL] = (lengths[LEVEL] == 0) ? 0 : (0xffffffffU << (32 - lengths[LEVEL]));
+            LEVEL += 1;
+        }
+
+        uint64_t left = _MEMORY / sizeof(Bucket);
+        for(int32_t i = LEVEL - 1;i >= 0;--i){
+            uint64_t needed = ((1ULL << lengths[i]) + COUNTER_PER_BUCKET - 1) / COUNTER_PER_BUCKET;
+            LENGTH[i] = std::min(needed, left / (i + 1));
+            if(LENGTH[i] == 0)
+                throw std::invalid_argument("HHH needs at least one bucket per level");
+            direct[i] = (LENGTH[i] == needed);
+            left -= LENGTH[i];
+            buckets[i] = new Bucket[LENGTH[i]];
+        }
+
+        name = "HHH ( " + std::to_string(LEVEL) + " levels" + (mode == SAMPLED ? ", sampled" : "") + " )";
+        Seed(0);
+        Clear();
+    }
+
+    ~HHH(){
+        for(uint32_t i = 0;i < LEVEL;++i)
+            delete [] buckets[i];
+    }
+
+    std::string name;
+
+    void Insert(const TUPLES& item, COUNT_TYPE weight = 1){
+        uint32_t ip = ntohl(item.srcIP());
+        uint32_t index[MAX_LEVEL];
+
+        if(mode == SAMPLED){
+            uint32_t level = random() % LEVEL;
+            Indices(ip, level, index);
+            Update(buckets[level][index[level]], ip & masks[level], weight);
+            return;
+        }
+
+        Indices(ip, 0, index);
+        for(uint32_t i = 0;i < LEVEL;++i)
+            Prefetch(&buckets[i][index[i]]);
+        for(uint32_t i = 0;i < LEVEL;++i)
+            Update(buckets[i][index[i]], ip & masks[i], weight);
+    }
+
+    /* Estimated count of the prefix of srcIP (network byte order) at level */
+    COUNT_TYPE Query(uint32_t level, uint32_t srcIP){
+        uint32_t ip = ntohl(srcIP), index[MAX_LEVEL];
+        Indices(ip, level, index);
+
+        const Bucket& bucket = buckets[level][index[level]];
+        for(uint32_t j = 0;j < COUNTER_PER_BUCKET;++j){
+            if(bucket.count[j] != 0 && bucket.ID[j] == (ip & masks[level]))
+                return Scale(bucket.count[j]);
+        }
+        return 0;
+    }
+
+    /* Prefixes whose count, minus that of their reported descendants, exceeds threshold */
+    std::vector<Prefix> Output(COUNT_TYPE threshold){
+        std::vector<HashMap> counts(LEVEL);
+        for(uint32_t i = 0;i < LEVEL;++i){
+            for(uint64_t k = 0;k < LENGTH[i];++k){
+                for(uint32_t j = 0;j < COUNTER_PER_BUCKET;++j){
+                    if(buckets[i][k].count[j] != 0)
+                        counts[i][buckets[i][k].ID[j]] = Scale(buckets[i][k].count[j]);
+                }
+            }
+        }
+        return Extract(counts, threshold);
+    }
+
+    /*
+     * Conditioned counts from per-level counts, longest prefix first. covered[p]
+     * is the total of the nearest reported descendants of p; a reported prefix
+     * replaces its descendants, since its count already includes them.
+     */
+    std::vector<Prefix> Extract(const std::vector<HashMap>& counts, COUNT_TYPE threshold) const{
+        std::vector<Prefix> ret;
+        HashMap covered, parent;
+
+        for(uint32_t i = 0;i < LEVEL;++i){
+            if(i > 0){
+                parent.clear();
+                for(auto it = covered.begin();it != covered.end();++it)
+                    parent[it->first & masks[i]] += it->second;
+                covered.swap(parent);
+            }
+
+            for(auto it = counts[i].begin();it != counts[i].end();++it){
+                auto find = covered.find(it->first);
+                COUNT_TYPE conditioned = it->second - ((find == covered.end()) ? 0 : find->second);
+                if(conditioned > threshold){
+                    ret.push_back({it->first, lengths[i], it->second, conditioned});
+                    covered[it->first] = it->second;
+                }
+            }
+        }
+
+        return ret;
+    }
+
+    /* Bucket hash and level sampling; set before the first Insert */
+    void Seed(uint32_t seed){
+        start = ((uint64_t)seed + 1) * 0x9e3779b97f4a7c15ULL;
+        random.Seed(seed);
+    }
+
+    void Clear(){
+        for(uint32_t i = 0;i < LEVEL;++i)
+            memset(buckets[i], 0, sizeof(Bucket) * LENGTH[i]);
+    }
+
+    inline uint32_t Levels() const{
+        return LEVEL;
+    }
+
+    inline uint32_t Length(uint32_t level) const{
+        return lengths[level];
+    }
+
+    inline uint32_t Mask(uint32_t level) const{
+        return masks[level];
+    }
+
+private:
+    Mode mode;
+    Random random;
+    uint64_t start;
+
+    uint32_t LEVEL;
+    uint32_t lengths[MAX_LEVEL];
+    uint32_t masks[MAX_LEVEL];
+
+    /* Buckets of each level; direct levels give every possible prefix its own slot */
+    uint64_t LENGTH[MAX_LEVEL];
+    bool direct[MAX_LEVEL];
+    Bucket* buckets[MAX_LEVEL];
+
+    /*
+     * Bucket of ip at the levels from the shortest prefix down to last. The
+     * hash state takes in one prefix per level, so the state of a level, and
+     * its bucket, depend on the prefix at that level only.
+     */
+    inline void Indices(uint32_t ip, uint32_t last, uint32_t* index) const{
+        uint64_t state = start;
+        for(int32_t i = LEVEL - 1;i >= (int32_t)last;--i){
+            uint32_t prefix = ip & masks[i];
+            state = (state ^ prefix) * 0xbf58476d1ce4e5b9ULL;
+            state ^= state >> 31;
+            if(direct[i])
+                index[i] = ((uint64_t)prefix >> (32 - lengths[i])) / COUNTER_PER_BUCKET;
+            else
+                index[i] = ((state * 0x94d049bb133111ebULL) >> 32) % LENGTH[i];
+        }
+    }
+
+    /*
+     * HeavyGuardian's replacement: the smallest slot of a full bucket decays
+     * with probability DECAY^-count, tested in floating point since DECAY^count
+     * passes 2^64 at a count of about 577
+     */
+    inline void Update(Bucket& bucket, SRC_IP prefix, COUNT_TYPE weight){
+        uint32_t minPos = 0;
+        for(uint32_t j = 0;j < COUNTER_PER_BUCKET;++j){
+            if(bucket.count[j] != 0 && bucket.ID[j] == prefix){
+                bucket.count[j] += weight;
+                return;
+            }
+            if(bucket.count[j] == 0){
+                bucket.ID[j] = prefix;
+                bucket.count[j] = weight;
+                return;
+            }
+            if(bucket.count[j] < bucket.count[minPos])
+                minPos = j;
+        }
+
+        COUNT_TYPE count = bucket.count[minPos];
+        COUNT_TYPE left = Decay(count, weight,
+            [](COUNT_TYPE c) { return std::pow(DECAY, c); },
+            [&]() { return random.Uniform() * std::pow(DECAY, count) < 1; }, random);
+
+        bucket.count[minPos] = count;
+        if(left > 0){
+            bucket.ID[minPos] = prefix;
+            bucket.count[minPos] = left;
+        }
+    }
+
+    inline COUNT_TYPE Scale(COUNT_TYPE count) const{
+        return (mode == SAMPLED) ? count * LEVEL : count;
+    }
+};
+
+constexpr uint32_t HHH::MAX_LEVEL;
+constexpr uint32_t HHH::COUNTER_PER_BUCKET;
+constexpr double HHH::DECAY;
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef HEAVYCHANGER_H
+#define HEAVYCHANGER_H
+
+#include "Abstract.h"
+
+/*
+ * Heavy changers between consecutive epochs. The previous and the current
+ * epoch each have a sketch built with the same hashing; the change of a flow is
+ * the difference of its two estimates, and the candidates are the flows either
+ * sketch reports. MVSketch is the natural choice, since its buckets keep the
+ * majority flow together with the bucket total.
+ */
+template<typename DATA_TYPE>
+class HeavyChanger{
+public:
+    typedef std::unordered_map<DATA_TYPE, COUNT_TYPE> HashMap;
+    typedef std::function<Abstract<DATA_TYPE>*(uint32_t)> Factory;
+
+    /* _MEMORY is the total for both epochs */
+    HeavyChanger(uint32_t _MEMORY, Factory factory){
+        previous = factory(_MEMORY / 2);
+        current = factory(_MEMORY / 2);
+        name = "HeavyChanger ( " + current->name + " x 2 )";
+        epoch = 0;
+    }
+
+    ~HeavyChanger(){
+        delete previous;
+        delete current;
+    }
+
+    std::string name;
+
+    inline void Insert(const DATA_TYPE& item, COUNT_TYPE weight = 1){
+        current->Insert(item, weight);
+    }
+
+    /* Close the current epoch; it becomes the reference for the next one */
+    void Rotate(){
+        std::swap(previous, current);
+        current->Clear();
+        epoch += 1;
+    }
+
+    /* Estimated change of item from the previous epoch to the current one */
+    COUNT_TYPE Query(const DATA_TYPE& item){
+        return current->Query(item) - previous->Query(item);
+    }
+
+    /* Flows whose count changed by more than threshold, with the signed change */
+    HashMap Changes(COUNT_TYPE threshold){
+        HashMap ret;
+        HashMap candidates = current->AllQuery();
+        HashMap before = previous->AllQuery();
+        candidates.insert(before.begin(), before.end());
+
+        for(auto it = candidates.begin();it != candidates.end();++it){
+            COUNT_TYPE change = Query(it->first);
+            if(std::abs(change) > threshold)
+                ret[it->first] = change;
+        }
+        return ret;
+    }
+
+    void Clear(){
+        previous->Clear();
+        current->Clear();
+        epoch = 0;
+    }
+
+    inline uint64_t Epoch() const{
+        return epoch;
+    }
+
+private:
+    Abstract<DATA_TYPE>* previous;
+    Abstract<DATA_TYPE>* current;
+    uint64_t epoch;
+};
+
+#endif
@@ -4,7 +4,7 @@
 #include "Abstract.h"
 #include <limits>
 
-template<typename DATA_TYPE>
+template<typename DATA_TYPE, uint32_t HASH_NUM = 4>
 class MVSketch : public Abstract<DATA_TYPE> {
 public:
 
@@ -14,6 +14,12 @@ public:
         COUNT_TYPE total_sum;
         DATA_TYPE ID;
         COUNT_TYPE counter;
+
+        void Code(Archive& ar){
+            ar.Count(total_sum);
+            ar.Key(ID);
+            ar.Count(counter);
+        }
     };
 
     MVSketch(uint32_t _MEMORY, uint32_t _STAGE1_BIAS = 0, std::string _name = "MVSketch"){
@@ -28,26 +34,34 @@ public:
         }
     }
 
+    MVSketch(){}
+
     ~MVSketch(){
-        for(uint32_t i = 0; i < HASH_NUM; ++i)
-            delete [] sketch[i];
+        if(!this->mapped && sketch != nullptr){
+            for(uint32_t i = 0; i < HASH_NUM; ++i)
+                delete [] sketch[i];
+        }
         delete [] sketch;
     }
 
     void Insert(const DATA_TYPE& item) {
+        Insert(item, 1);
+    }
+
+    void Insert(const DATA_TYPE& item, COUNT_TYPE weight) {
         for(uint32_t i = 0; i < HASH_NUM; ++i) {
-            uint32_t pos = hash(item, i) % LENGTH;    
-            sketch[i][pos].total_sum++;
-            if (sketch[i][pos].ID[0] == '\0') {
+            uint32_t pos = hash(item, i, this->seed) % LENGTH;    
+            sketch[i][pos].total_sum += weight;
+            if (sketch[i][pos].total_sum == 0) {
                 sketch[i][pos].ID = item;
-                sketch[i][pos].counter = 1;
+                sketch[i][pos].counter = weight;
             }
             else if (item == sketch[i][pos].ID) {
-                sketch[i][pos].counter++;
+                sketch[i][pos].counter += weight;
             }
-            else if (--sketch[i][pos].counter < 0) {
+            else if ((sketch[i][pos].counter -= weight) < 0) {
                 sketch[i][pos].ID = item;
-                sketch[i][pos].counter = 1;
+                sketch[i][pos].counter = -sketch[i][pos].counter;
             }
         }
     }
@@ -56,7 +70,7 @@ public:
         COUNT_TYPE ret = std::numeric_limits<COUNT_TYPE>::max();
 
         for(uint32_t i = 0; i < HASH_NUM; ++i) {
-            uint32_t pos = hash(item, i) % LENGTH;    
+            uint32_t pos = hash(item, i, this->seed) % LENGTH;    
             if (sketch[i][pos].ID == item) {
                 ret = std::min(ret, (sketch[i][pos].total_sum + sketch[i][pos].counter) / 2);
             }
@@ -68,12 +82,39 @@ public:
         return ret;
     }
 
+    void QueryBatch(const DATA_TYPE* keys, COUNT_TYPE* out, size_t n){
+        constexpr uint32_t GROUP = std::max<uint32_t>(Abstract<DATA_TYPE>::PREFETCH_SLOTS / HASH_NUM, 1);
+        uint32_t positions[GROUP][HASH_NUM], hashed[GROUP];
+
+        for(size_t begin = 0;begin < n;begin += GROUP){
+            uint32_t size = std::min<size_t>(GROUP, n - begin);
+            for(uint32_t i = 0;i < HASH_NUM;++i){
+                HashBatch(keys + begin, (const uint32_t*)nullptr, size, i, this->seed, hashed);
+                for(uint32_t k = 0;k < size;++k){
+                    positions[k][i] = hashed[k] % LENGTH;
+                    Prefetch(&sketch[i][positions[k][i]]);
+                }
+            }
+            for(uint32_t k = 0;k < size;++k){
+                COUNT_TYPE ret = std::numeric_limits<COUNT_TYPE>::max();
+                for(uint32_t i = 0;i < HASH_NUM;++i){
+                    const Bucket& bucket = sketch[i][positions[k][i]];
+                    if(bucket.ID == keys[begin + k])
+                        ret = std::min(ret, (bucket.total_sum + bucket.counter) / 2);
+                    else
+                        ret = std::min(ret, (bucket.total_sum - bucket.counter) / 2);
+                }
+                out[begin + k] = ret;
+            }
+        }
+    }
+
     HashMap AllQuery(){
         HashMap ret;
 
         for(uint32_t i = 0; i < HASH_NUM; ++i){
             for (uint32_t j = 0; j < LENGTH; ++j) {
-                if (sketch[i][j].ID[0] != '\0' && ret.find(sketch[i][j].ID) == ret.end()) {
+                if (sketch[i][j].total_sum != 0 && ret.find(sketch[i][j].ID) == ret.end()) {
                     ret[sketch[i][j].ID] = Query(sketch[i][j].ID) + this->stage1_bias;
                 }
             }
@@ -82,12 +123,32 @@ public:
         return ret;
     }
 
+    void Clear(){
+        for(uint32_t i = 0; i < HASH_NUM; ++i)
+            memset(sketch[i], 0, sizeof(Bucket) * LENGTH);
+    }
+
+    void Serialize(Archive& ar){
+        ar.Section(KIND_MVSKETCH);
+        ar.Attach(this->mapped);
+        ar.String(this->name);
+        ar.Param(HASH_NUM);
+        ar.Value(this->stage1_bias);
+        ar.Value(this->seed);
+        ar.Value(this->random);
+        ar.Value(LENGTH);
+
+        if(ar.Loading())
+            sketch = new Bucket* [HASH_NUM]();
+        for(uint32_t i = 0; i < HASH_NUM; ++i)
+            ar.Array(sketch[i], LENGTH);
+    }
+
 private:
 
     uint32_t LENGTH;
-    const uint32_t HASH_NUM = 4;
 
-    Bucket** sketch;
+    Bucket** sketch = nullptr;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,158 @@
+#ifndef MULTIKEY_H
+#define MULTIKEY_H
+
+#include "Abstract.h"
+#include <limits>
+
+/* Partial key of a TUPLES: the masked-out bits are zeroed, so it is still a TUPLES */
+struct KeyMask{
+    std::string name;
+    uint8_t mask[TUPLES_LEN];
+
+    KeyMask(std::string _name = "5-tuple"){
+        name = _name;
+        memset(mask, 0xff, sizeof(mask));
+    }
+
+    /* Keep only the given field prefixes, e.g. Keep(0, 24) for the /24 of srcIP */
+    KeyMask& Keep(uint32_t offset, uint32_t bits){
+        if(bits == 0 || offset + (bits + 7) / 8 > TUPLES_LEN)
+            throw std::invalid_argument("Key field is outside of TUPLES");
+        if(full){
+            memset(mask, 0, sizeof(mask));
+            full = false;
+        }
+        for(uint32_t i = 0;i < bits;++i)
+            mask[offset + i / 8] |= 0x80 >> (i % 8);
+        return *this;
+    }
+
+    inline TUPLES Apply(const TUPLES& item) const{
+        TUPLES ret;
+        for(uint32_t i = 0;i < TUPLES_LEN;++i)
+            ret.data[i] = item.data[i] & mask[i];
+        return ret;
+    }
+
+    static KeyMask FiveTuple(){ return KeyMask("5-tuple"); }
+    static KeyMask SrcIP(){ return KeyMask("srcIP").Keep(0, 32); }
+    static KeyMask DstIP(){ return KeyMask("dstIP").Keep(4, 32); }
+    static KeyMask SrcDst(){ return KeyMask("srcIP/dstIP").Keep(0, 64); }
+    static KeyMask SrcPrefix(uint32_t bits){ return KeyMask("srcIP/" + std::to_string(bits)).Keep(0, bits); }
+
+private:
+    bool full = true;
+};
+
+/*
+ * Heavy hitters for several partial keys from one pass over the packets.
+ *   PER_KEY: one sketch per key, each fed the masked packet.
+ *   SHARED:  one sketch over the full key; a partial key is answered by summing
+ *            the reported full keys that map to it, as in CocoSketch.
+ * SHARED hashes each packet once; PER_KEY only shares the packet read, since
+ * every key hashes differently.
+ */
+class MultiKey{
+public:
+    typedef std::unordered_map<TUPLES, COUNT_TYPE> HashMap;
+    typedef std::function<Abstract<TUPLES>*(uint32_t)> Factory;
+
+    enum Mode{
+        PER_KEY,
+        SHARED
+    };
+
+    /* _MEMORY is the total; PER_KEY splits it evenly between the keys */
+    MultiKey(uint32_t _MEMORY, const std::vector<KeyMask>& _masks, Factory factory, Mode _mode = PER_KEY){
+        if(_masks.empty())
+            throw std::invalid_argument("MultiKey needs at least one key");
+
+        masks = _masks;
+        mode = _mode;
+
+        if(mode == PER_KEY){
+            for(uint32_t i = 0;i < masks.size();++i)
+                sketches.push_back(factory(_MEMORY / masks.size()));
+        }
+        else{
+            sketches.push_back(factory(_MEMORY));
+        }
+
+        name = "MultiKey ( " + sketches[0]->name + (mode == PER_KEY ? " x " + std::to_string(masks.size()) : " shared") + " )";
+        version = 0;
+        cached.resize(masks.size());
+        cachedVersion.assign(masks.size(), std::numeric_limits<uint64_t>::max());
+    }
+
+    ~MultiKey(){
+        for(auto sketch : sketches)
+            delete sketch;
+    }
+
+    std::string name;
+
+    void Insert(const TUPLES& item, COUNT_TYPE weight = 1){
+        if(mode == PER_KEY){
+            for(uint32_t i = 0;i < masks.size();++i)
+                sketches[i]->Insert(masks[i].Apply(item), weight);
+        }
+        else{
+            sketches[0]->Insert(item, weight);
+        }
+        version += 1;
+    }
+
+    /* Estimate of the partial key of item under key number key */
+    COUNT_TYPE Query(uint32_t key, const TUPLES& item){
+        if(mode == PER_KEY)
+            return sketches[key]->Query(masks[key].Apply(item));
+
+        const HashMap& mp = Aggregate(key);
+        auto it = mp.find(masks[key].Apply(item));
+        return (it == mp.end()) ? 0 : it->second;
+    }
+
+    HashMap AllQuery(uint32_t key){
+        if(mode == PER_KEY)
+            return sketches[key]->AllQuery();
+        return Aggregate(key);
+    }
+
+    void Clear(){
+        for(auto sketch : sketches)
+            sketch->Clear();
+        version += 1;
+    }
+
+    inline uint32_t Keys() const{
+        return masks.size();
+    }
+
+    inline const KeyMask& Mask(uint32_t key) const{
+        return masks[key];
+    }
+
+private:
+    std::vector<KeyMask> masks;
+    Mode mode;
+
+    std::vector<Abstract<TUPLES>*> sketches;
+
+    /* SHARED mode: per-key sums of the full-key report, rebuilt after inserts */
+    uint64_t version;
+    std::vector<HashMap> cached;
+    std::vector<uint64_t> cachedVersion;
+
+    const HashMap& Aggregate(uint32_t key){
+        if(cachedVersion[key] != version){
+            HashMap full = sketches[0]->AllQuery();
+            cached[key].clear();
+            for(auto it = full.begin();it != full.end();++it)
+                cached[key][masks[key].Apply(it->first)] += it->second;
+            cachedVersion[key] = version;
+        }
+        return cached[key];
+    }
+};
+
+#endif
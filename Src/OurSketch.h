@@ -23,6 +23,13 @@ public:
             }
             return 0;
         }
+
+        void Code(Archive& ar) {
+            for(uint32_t i = 0; i < COUNTER_PER_BUCKET; i++) {
+                ar.Key(ID[i]);
+                ar.Count(count[i]);
+            }
+        }
     };
 
     OurSketch(uint32_t _MEMORY, uint32_t _STAGE1_BIAS = 0, std::string _name = "OurSketch"){
@@ -36,24 +43,31 @@ public:
         memset(buckets, 0, sizeof(Bucket) * LENGTH);
     }
 
+    OurSketch(){}
+
     ~OurSketch(){
-        delete [] buckets;
+        if(!this->mapped)
+            delete [] buckets;
     }
 
     void Insert(const DATA_TYPE& item) {
-        uint32_t pos = hash(item) % LENGTH;
+        Insert(item, 1);
+    }
+
+    void Insert(const DATA_TYPE& item, COUNT_TYPE weight) {
+        uint32_t pos = hash(item, 0, this->seed) % LENGTH;
         int minPos = -1;
         COUNT_TYPE minVal = std::numeric_limits<COUNT_TYPE>::max();
 
         for (uint32_t i = 0; i < COUNTER_PER_BUCKET; i++){
             if(buckets[pos].ID[i] == item){
-                buckets[pos].count[i]++;
+                buckets[pos].count[i] += weight;
                 return;
             }
 
             if(buckets[pos].count[i] == 0){
                 buckets[pos].ID[i] = item;
-                buckets[pos].count[i] = 1;
+                buckets[pos].count[i] = weight;
                 return;
             }
 
@@ -63,14 +77,14 @@ public:
             }
         }
         // 1.original
-        buckets[pos].count[minPos]++;
-        if (randomGenerator() % (buckets[pos].count[minPos]) == 0) {
+        buckets[pos].count[minPos] += weight;
+        if (this->random() % (buckets[pos].count[minPos]) < (uint32_t)weight) {
             buckets[pos].ID[minPos] = item;
-            buckets[pos].count[minPos] = 1;
+            buckets[pos].count[minPos] = weight;
         }
 
         // 2.decay
-        // if (randomGenerator() % (int)(std::pow(1.08, buckets[pos].count[minPos])) == 0) {
+        // if (this->random() % (int)(std::pow(1.08, buckets[pos].count[minPos])) == 0) {
         //     if (--buckets[pos].count[minPos] <= 0) {
         //         buckets[pos].ID[minPos] = item;
         //         buckets[pos].count[minPos] = 1;                
@@ -79,14 +93,30 @@ public:
     }
 
     COUNT_TYPE Query(const DATA_TYPE& item){
-        return buckets[hash(item) % LENGTH].Query(item);
+        return buckets[hash(item, 0, this->seed) % LENGTH].Query(item);
+    }
+
+    void QueryBatch(const DATA_TYPE* keys, COUNT_TYPE* out, size_t n){
+        constexpr uint32_t GROUP = Abstract<DATA_TYPE>::PREFETCH_SLOTS;
+        uint32_t positions[GROUP];
+
+        for(size_t begin = 0;begin < n;begin += GROUP){
+            uint32_t size = std::min<size_t>(GROUP, n - begin);
+            HashBatch(keys + begin, (const uint32_t*)nullptr, size, 0, this->seed, positions);
+            for(uint32_t k = 0;k < size;++k){
+                positions[k] %= LENGTH;
+                Prefetch(&buckets[positions[k]]);
+            }
+            for(uint32_t k = 0;k < size;++k)
+                out[begin + k] = buckets[positions[k]].Query(keys[begin + k]);
+        }
     }
 
     HashMap AllQuery(){
         HashMap ret;
         for(uint32_t i = 0; i < LENGTH; ++i){
             for(uint32_t j = 0; j < COUNTER_PER_BUCKET; ++j) {
-                if (buckets[i].ID[j][0] != '\0') {
+                if (buckets[i].count[j] != 0) {
                     ret[buckets[i].ID[j]] = buckets[i].count[j] + this->stage1_bias;
                 }
             }
@@ -94,9 +124,25 @@ public:
         return ret;
     }
 
+    void Clear(){
+        memset(buckets, 0, sizeof(Bucket) * LENGTH);
+    }
+
+    void Serialize(Archive& ar){
+        ar.Section(KIND_OURSKETCH);
+        ar.Attach(this->mapped);
+        ar.String(this->name);
+        ar.Param(COUNTER_PER_BUCKET);
+        ar.Value(this->stage1_bias);
+        ar.Value(this->seed);
+        ar.Value(this->random);
+        ar.Value(LENGTH);
+        ar.Array(buckets, LENGTH);
+    }
+
 private:
     uint32_t LENGTH;
-    Bucket* buckets;
+    Bucket* buckets = nullptr;
 };
 
 #endif
\ No newline at end of file
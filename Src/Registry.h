@@ -0,0 +1,110 @@
+#ifndef REGISTRY_H
+#define REGISTRY_H
+
+#include "Abstract.h"
+#include "CocoSketch.h"
+#include "UnivMon.h"
+#include "Elastic.h"
+#include "CMHeap.h"
+#include "CountHeap.h"
+#include "SpaceSaving.h"
+#include "MVSketch.h"
+#include "StableSketch.h"
+#include "TwoStage.h"
+#include "OurSketch.h"
+#include "ElasticHeavyPart.h"
+#include "HeavyGuardian.h"
+#include "TwoFASketch.h"
+#include "TightSketch.h"
+#include "OurSketch2.h"
+
+/*
+ * Heavy-hitter sketches by name, for choosing them at run time. A factory takes
+ * the memory in bytes and the heavy-hitter threshold in packets; only the
+ * sketches marked thresholded are built differently for another threshold.
+ */
+template<typename DATA_TYPE>
+struct SketchEntry{
+    std::string name;
+    std::function<Abstract<DATA_TYPE>*(uint32_t, COUNT_TYPE)> factory;
+    bool thresholded;
+};
+
+template<typename DATA_TYPE>
+const std::vector<SketchEntry<DATA_TYPE>>& SketchRegistry(){
+    typedef Abstract<DATA_TYPE>* Sketch;
+    static const std::vector<SketchEntry<DATA_TYPE>> registry = {
+        {"CocoSketch", [](uint32_t memory, COUNT_TYPE) -> Sketch { return new CocoSketch<DATA_TYPE>(memory); }, false},
+        {"UnivMon", [](uint32_t memory, COUNT_TYPE) -> Sketch { return new UnivMon<DATA_TYPE>(memory); }, false},
+        {"Elastic", [](uint32_t memory, COUNT_TYPE) -> Sketch { return new Elastic<DATA_TYPE>(memory); }, false},
+        {"CMHeap", [](uint32_t memory, COUNT_TYPE) -> Sketch { return new CMHeap<DATA_TYPE>(memory); }, false},
+        {"CMHeapCU", [](uint32_t memory, COUNT_TYPE) -> Sketch { return new CMHeap<DATA_TYPE, COUNT_TYPE, 4, true>(memory, "CMHeap (conservative)"); }, false},
+        {"CountHeap", [](uint32_t memory, COUNT_TYPE) -> Sketch { return new CountHeap<DATA_TYPE>(memory); }, false},
+        {"SpaceSaving", [](uint32_t memory, COUNT_TYPE) -> Sketch { return new SpaceSaving<DATA_TYPE>(memory); }, false},
+        {"MVSketch", [](uint32_t memory, COUNT_TYPE) -> Sketch { return new MVSketch<DATA_TYPE>(memory); }, false},
+        {"StableSketch", [](uint32_t memory, COUNT_TYPE) -> Sketch { return new StableSketch<DATA_TYPE>(memory); }, false},
+        {"TwoStage", [](uint32_t memory, COUNT_TYPE threshold) -> Sketch { return new TwoStage<DATA_TYPE>(memory, threshold); }, true},
+        {"OurSketch", [](uint32_t memory, COUNT_TYPE) -> Sketch { return new OurSketch<DATA_TYPE>(memory); }, false},
+        {"ElasticHeavyPart", [](uint32_t memory, COUNT_TYPE) -> Sketch { return new ElasticHeavyPart<DATA_TYPE>(memory); }, false},
+        {"HeavyGuardian", [](uint32_t memory, COUNT_TYPE) -> Sketch { return new HeavyGuardian<DATA_TYPE>(memory); }, false},
+        {"TwoFASketch", [](uint32_t memory, COUNT_TYPE) -> Sketch { return new TwoFASketch<DATA_TYPE>(memory); }, false},
+        {"TightSketch", [](uint32_t memory, COUNT_TYPE) -> Sketch { return new TightSketch<DATA_TYPE>(memory); }, false},
+        {"OurSketch2", [](uint32_t memory, COUNT_TYPE) -> Sketch { return new OurSketch2<DATA_TYPE>(memory); }, false}
+    };
+    return registry;
+}
+
+template<typename DATA_TYPE>
+const SketchEntry<DATA_TYPE>& FindSketch(const std::string& name){
+    for(auto& entry : SketchRegistry<DATA_TYPE>()){
+        if(entry.name == name)
+            return entry;
+    }
+    throw std::invalid_argument("Unknown sketch " + name);
+}
+
+template<typename DATA_TYPE>
+Abstract<DATA_TYPE>* CreateSketch(const std::string& name, uint32_t memory, COUNT_TYPE threshold = 0){
+    return FindSketch<DATA_TYPE>(name).factory(memory, threshold);
+}
+
+/* A run-time parameter of a sketch besides its memory, with the values worth trying */
+struct Knob{
+    std::string name;
+    std::vector<double> values;
+};
+
+/*
+ * A registered sketch with the knobs it can be tuned over; the factory takes
+ * one value per knob, in order. Sketches without run-time knobs have none.
+ */
+template<typename DATA_TYPE>
+struct TunableEntry{
+    std::string name;
+    std::vector<Knob> knobs;
+    std::function<Abstract<DATA_TYPE>*(uint32_t, COUNT_TYPE, const std::vector<double>&)> factory;
+};
+
+template<typename DATA_TYPE>
+TunableEntry<DATA_TYPE> FindTunable(const std::string& name){
+    typedef Abstract<DATA_TYPE>* Sketch;
+    if(name == "CocoSketch"){
+        return {name, {{"HASH_NUM", {1, 2, 3, 4}}},
+                [](uint32_t memory, COUNT_TYPE, const std::vector<double>& knob) -> Sketch {
+                    return new CocoSketch<DATA_TYPE>(memory, 0, knob[0]);
+                }};
+    }
+    if(name == "TwoStage"){
+        return {name, {{"FILTER_RATIO", {0.25, 0.5, 0.75}}, {"STAGE1_THRESHOLD_RATIO", {0.25, 0.5, 0.75}}},
+                [](uint32_t memory, COUNT_TYPE threshold, const std::vector<double>& knob) -> Sketch {
+                    return new TwoStage<DATA_TYPE>(memory, threshold, knob[0], knob[1]);
+                }};
+    }
+
+    auto factory = FindSketch<DATA_TYPE>(name).factory;
+    return {name, {}, [factory](uint32_t memory, COUNT_TYPE threshold, const std::vector<double>&) -> Sketch {
+        return factory(memory, threshold);
+    }};
+}
+
+#endif
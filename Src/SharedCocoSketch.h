@@ -0,0 +1,192 @@
+#ifndef SHAREDCOCOSKETCH_H
+#define SHAREDCOCOSKETCH_H
+
+#include "Abstract.h"
+#include <limits>
+
+/*
+ * CocoSketch for many concurrent writers on one table. Counts live in their own
+ * aligned arrays and are updated with relaxed atomic adds; the IDs sit next to
+ * them with the same geometry, so the memory per slot matches CocoSketch.
+ * Replacing an ID takes the top bit of the slot count with an atomic
+ * test-and-set, so two writers never interleave their bytes; a writer that
+ * finds the bit taken drops its replacement, which is just another outcome of
+ * the random choice. A lookup may still read an ID while it is being replaced
+ * and miss; the update then goes to the minimum slot instead.
+ * Each writer thread names itself with Writer(index) and draws the random
+ * choices from its own stream of this sketch, derived from the seed and the
+ * index; writer 0, the default, draws from this->random, so a single writer
+ * repeats the run of the seed.
+ * Query and AllQuery are for after the writers have been joined.
+ */
+template<typename DATA_TYPE>
+class SharedCocoSketch : public Abstract<DATA_TYPE>{
+public:
+    typedef std::unordered_map<DATA_TYPE, COUNT_TYPE> HashMap;
+    static constexpr uint32_t MAX_WRITERS = 64;
+
+    SharedCocoSketch(uint32_t _MEMORY, uint32_t _STAGE1_BIAS = 0, uint32_t _HASH_NUM = 2, std::string _name = "SharedCocoSketch"){
+        this->name = _name;
+
+        HASH_NUM = _HASH_NUM;
+        LENGTH = _MEMORY / _HASH_NUM / (sizeof(DATA_TYPE) + sizeof(COUNT_TYPE));
+        this->stage1_bias = _STAGE1_BIAS;
+
+        ID = new DATA_TYPE* [HASH_NUM];
+        count = new COUNT_TYPE* [HASH_NUM];
+        for(uint32_t i = 0;i < HASH_NUM;++i){
+            ID[i] = new DATA_TYPE [LENGTH];
+            count[i] = new COUNT_TYPE [LENGTH];
+        }
+        streams.resize(MAX_WRITERS);
+        SeedStreams();
+        Clear();
+    }
+
+    SharedCocoSketch(){}
+
+    ~SharedCocoSketch(){
+        if(!this->mapped && ID != nullptr && count != nullptr){
+            for(uint32_t i = 0;i < HASH_NUM;++i){
+                delete [] ID[i];
+                delete [] count[i];
+            }
+        }
+        delete [] ID;
+        delete [] count;
+    }
+
+    /* Index of the calling thread among the writers of every SharedCocoSketch, below MAX_WRITERS */
+    static void Writer(uint32_t index){
+        if(index >= MAX_WRITERS)
+            throw std::invalid_argument("SharedCocoSketch writer index must be below " + std::to_string(MAX_WRITERS));
+        WriterIndex() = index;
+    }
+
+    void Seed(uint32_t _seed){
+        Abstract<DATA_TYPE>::Seed(_seed);
+        SeedStreams();
+    }
+
+    void Insert(const DATA_TYPE& item){
+        Insert(item, 1);
+    }
+
+    /* Safe to call from any number of threads at once */
+    void Insert(const DATA_TYPE& item, COUNT_TYPE weight){
+        COUNT_TYPE minimum = std::numeric_limits<COUNT_TYPE>::max();
+        uint32_t minPos = 0, minHash = 0;
+
+        for(uint32_t i = 0;i < HASH_NUM;++i){
+            uint32_t position = hash(item, i, this->seed) % LENGTH;
+            if(ID[i][position] == item){
+                __atomic_fetch_add(&count[i][position], weight, __ATOMIC_RELAXED);
+                return;
+            }
+            COUNT_TYPE value = __atomic_load_n(&count[i][position], __ATOMIC_RELAXED) & COUNT_MASK;
+            if(value < minimum){
+                minPos = position;
+                minHash = i;
+                minimum = value;
+            }
+        }
+
+        COUNT_TYPE* slot = &count[minHash][minPos];
+        COUNT_TYPE total = (__atomic_add_fetch(slot, weight, __ATOMIC_RELAXED) & COUNT_MASK);
+        if(Draw() % total < (uint32_t)weight){
+            if(__atomic_fetch_or(slot, WRITING, __ATOMIC_ACQUIRE) & WRITING)
+                return;
+            ID[minHash][minPos] = item;
+            __atomic_fetch_and(slot, COUNT_MASK, __ATOMIC_RELEASE);
+        }
+    }
+
+    COUNT_TYPE Query(const DATA_TYPE& item){
+        for(uint32_t i = 0; i < HASH_NUM; ++i) {
+            uint32_t position = hash(item, i, this->seed) % LENGTH;
+            if(ID[i][position] == item){
+                return (count[i][position] & COUNT_MASK) + this->stage1_bias;
+            }
+        }
+        return 0;
+    }
+
+    HashMap AllQuery(){
+        HashMap ret;
+
+        for(uint32_t i = 0;i < HASH_NUM;++i){
+            for(uint32_t j = 0;j < LENGTH;++j){
+                if((count[i][j] & COUNT_MASK) != 0)
+                    ret[ID[i][j]] = (count[i][j] & COUNT_MASK) + this->stage1_bias;
+            }
+        }
+
+        return ret;
+    }
+
+    void Clear(){
+        for(uint32_t i = 0;i < HASH_NUM;++i){
+            memset(ID[i], 0, sizeof(DATA_TYPE) * LENGTH);
+            memset(count[i], 0, sizeof(COUNT_TYPE) * LENGTH);
+        }
+    }
+
+    void Serialize(Archive& ar){
+        ar.Section(KIND_SHAREDCOCOSKETCH);
+        ar.Attach(this->mapped);
+        ar.String(this->name);
+        ar.Value(this->stage1_bias);
+        ar.Value(this->seed);
+        ar.Value(this->random);
+        ar.Value(HASH_NUM);
+        ar.Value(LENGTH);
+
+        if(ar.Loading()){
+            ID = new DATA_TYPE* [HASH_NUM]();
+            count = new COUNT_TYPE* [HASH_NUM]();
+            streams.resize(MAX_WRITERS);
+            SeedStreams();
+        }
+        for(uint32_t i = 0;i < HASH_NUM;++i){
+            ar.Array(ID[i], LENGTH);
+            ar.Array(count[i], LENGTH);
+        }
+    }
+
+private:
+    static constexpr COUNT_TYPE WRITING = std::numeric_limits<COUNT_TYPE>::min();
+    static constexpr COUNT_TYPE COUNT_MASK = std::numeric_limits<COUNT_TYPE>::max();
+
+    uint32_t LENGTH;
+    uint32_t HASH_NUM;
+
+    DATA_TYPE** ID = nullptr;
+    COUNT_TYPE** count = nullptr;
+
+    /* The stream of writer w, w > 0, padded to a cache line of its own */
+    struct Stream{
+        Random random;
+        uint8_t padding[64 - sizeof(Random)];
+    };
+    std::vector<Stream> streams;
+
+    static uint32_t& WriterIndex(){
+        static thread_local uint32_t index = 0;
+        return index;
+    }
+
+    void SeedStreams(){
+        for(uint32_t w = 1;w < MAX_WRITERS;++w)
+            streams[w].random.Seed(hash64(w, 0, this->seed));
+    }
+
+    inline uint32_t Draw(){
+        uint32_t writer = WriterIndex();
+        return (writer == 0) ? this->random() : streams[writer].random();
+    }
+};
+
+template<typename DATA_TYPE>
+constexpr uint32_t SharedCocoSketch<DATA_TYPE>::MAX_WRITERS;
+
+#endif
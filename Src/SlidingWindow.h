@@ -0,0 +1,160 @@
+#ifndef SLIDINGWINDOW_H
+#define SLIDINGWINDOW_H
+
+#include "Abstract.h"
+
+/*
+ * Jumping-window wrapper: the window of WINDOW ticks is split into SUB_WINDOW
+ * sub-epochs, each counted by its own sketch. When a new sub-epoch starts the
+ * oldest sketch is cleared and reused, so the sketches always cover the last
+ * (SUB_WINDOW - 1) full sub-epochs plus the current one.
+ *
+ * By default every Insert is one tick (packet-count window). With TIME_DRIVEN
+ * set, the caller moves the clock with Advance(timestamp) instead.
+ */
+template<typename DATA_TYPE>
+class SlidingWindow : public Abstract<DATA_TYPE>{
+public:
+    typedef std::unordered_map<DATA_TYPE, COUNT_TYPE> HashMap;
+    typedef std::function<Abstract<DATA_TYPE>*(uint32_t)> Factory;
+
+    SlidingWindow(uint32_t _MEMORY, uint64_t _WINDOW, uint32_t _SUB_WINDOW, Factory factory,
+                  bool _TIME_DRIVEN = false, std::string _name = "SlidingWindow"){
+        if(_SUB_WINDOW == 0)
+            throw std::invalid_argument("SlidingWindow needs at least one sub-window");
+        if(_SUB_WINDOW > _WINDOW)
+            throw std::invalid_argument("SlidingWindow cannot have more sub-windows than ticks in its window");
+
+        SUB_WINDOW = _SUB_WINDOW;
+        SUB_LENGTH = _WINDOW / _SUB_WINDOW;
+        TIME_DRIVEN = _TIME_DRIVEN;
+
+        sketches = new Abstract<DATA_TYPE>* [SUB_WINDOW];
+        for(uint32_t i = 0;i < SUB_WINDOW;++i){
+            sketches[i] = factory(_MEMORY / SUB_WINDOW);
+        }
+
+        this->name = _name + " ( " + sketches[0]->name + " x " + std::to_string(SUB_WINDOW) + " )";
+
+        clock = 0;
+        epoch = 0;
+        head = 0;
+    }
+
+    SlidingWindow(){}
+
+    ~SlidingWindow(){
+        for(uint32_t i = 0;sketches != nullptr && i < SUB_WINDOW;++i){
+            delete sketches[i];
+        }
+        delete [] sketches;
+    }
+
+    void Advance(uint64_t now){
+        if(now < clock)
+            return;
+
+        clock = now;
+        uint64_t current = clock / SUB_LENGTH;
+
+        if(current - epoch >= SUB_WINDOW){
+            for(uint32_t i = 0;i < SUB_WINDOW;++i){
+                sketches[i]->Clear();
+            }
+            epoch = current;
+        }
+
+        while(epoch < current){
+            head = (head + 1) % SUB_WINDOW;
+            sketches[head]->Clear();
+            epoch += 1;
+        }
+    }
+
+    void Insert(const DATA_TYPE& item){
+        Insert(item, 1);
+    }
+
+    /* The window counts packets (or time), whatever their weight */
+    void Insert(const DATA_TYPE& item, COUNT_TYPE weight){
+        if(!TIME_DRIVEN){
+            if(clock / SUB_LENGTH != epoch)
+                Advance(clock);
+            clock += 1;
+        }
+        sketches[head]->Insert(item, weight);
+    }
+
+    COUNT_TYPE Query(const DATA_TYPE& item){
+        COUNT_TYPE ret = 0;
+        for(uint32_t i = 0;i < SUB_WINDOW;++i){
+            ret += sketches[i]->Query(item);
+        }
+        return ret;
+    }
+
+    HashMap AllQuery(){
+        HashMap ret;
+
+        for(uint32_t i = 0;i < SUB_WINDOW;++i){
+            HashMap temp = sketches[i]->AllQuery();
+            for(auto it = temp.begin();it != temp.end();++it){
+                if(ret.find(it->first) == ret.end()){
+                    ret[it->first] = Query(it->first);
+                }
+            }
+        }
+
+        return ret;
+    }
+
+    /* Sub-windows hash alike, so that their estimates of a flow add up */
+    void Seed(uint32_t _seed){
+        Abstract<DATA_TYPE>::Seed(_seed);
+        for(uint32_t i = 0;i < SUB_WINDOW;++i){
+            sketches[i]->Seed(_seed);
+        }
+    }
+
+    void Clear(){
+        for(uint32_t i = 0;i < SUB_WINDOW;++i){
+            sketches[i]->Clear();
+        }
+        clock = 0;
+        epoch = 0;
+        head = 0;
+    }
+
+    void Serialize(Archive& ar){
+        ar.Section(KIND_SLIDINGWINDOW);
+        ar.String(this->name);
+        ar.Value(this->seed);
+        ar.Value(SUB_WINDOW);
+        ar.Value(SUB_LENGTH);
+        ar.Value(TIME_DRIVEN);
+        ar.Value(clock);
+        ar.Value(epoch);
+        ar.Value(head);
+
+        if(ar.Loading())
+            sketches = new Abstract<DATA_TYPE>* [SUB_WINDOW]();
+        for(uint32_t i = 0;i < SUB_WINDOW;++i){
+            if(ar.Loading())
+                sketches[i] = NewSketch<DATA_TYPE>(ar.Peek());
+            sketches[i]->Serialize(ar);
+        }
+    }
+
+private:
+    uint32_t SUB_WINDOW;
+    uint64_t SUB_LENGTH;
+    bool TIME_DRIVEN;
+
+    uint64_t clock;
+    uint64_t epoch;
+    uint32_t head;
+
+    Abstract<DATA_TYPE>** sketches = nullptr;
+};
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "Abstract.h"
+
+#include "CocoSketch.h"
+#include "UnivMon.h"
+#include "Elastic.h"
+#include "CMHeap.h"
+#include "CountHeap.h"
+#include "SpaceSaving.h"
+#include "MVSketch.h"
+#include "StableSketch.h"
+#include "TwoStage.h"
+#include "OurSketch.h"
+#include "ElasticHeavyPart.h"
+#include "HeavyGuardian.h"
+#include "TwoFASketch.h"
+#include "TightSketch.h"
+#include "OurSketch2.h"
+#include "SlidingWindow.h"
+#include "SharedCocoSketch.h"
+#include "Cardinality.h"
+
+template<typename DATA_TYPE>
+Abstract<DATA_TYPE>* NewSketch(uint32_t kind){
+    switch(kind){
+        case KIND_COCOSKETCH: return new CocoSketch<DATA_TYPE>();
+        case KIND_UNIVMON: return new UnivMon<DATA_TYPE>();
+        case KIND_ELASTIC: return new Elastic<DATA_TYPE>();
+        case KIND_CMHEAP: return new CMHeap<DATA_TYPE>();
+        case KIND_COUNTHEAP: return new CountHeap<DATA_TYPE>();
+        case KIND_SPACESAVING: return new SpaceSaving<DATA_TYPE>();
+        case KIND_MVSKETCH: return new MVSketch<DATA_TYPE>();
+        case KIND_STABLESKETCH: return new StableSketch<DATA_TYPE>();
+        case KIND_TWOSTAGE: return new TwoStage<DATA_TYPE>();
+        case KIND_OURSKETCH: return new OurSketch<DATA_TYPE>();
+        case KIND_ELASTICHEAVYPART: return new ElasticHeavyPart<DATA_TYPE>();
+        case KIND_HEAVYGUARDIAN: return new HeavyGuardian<DATA_TYPE>();
+        case KIND_TWOFASKETCH: return new TwoFASketch<DATA_TYPE>();
+        case KIND_TIGHTSKETCH: return new TightSketch<DATA_TYPE>();
+        case KIND_OURSKETCH2: return new OurSketch2<DATA_TYPE>();
+        case KIND_SLIDINGWINDOW: return new SlidingWindow<DATA_TYPE>();
+        case KIND_SHAREDCOCOSKETCH: return new SharedCocoSketch<DATA_TYPE>();
+        case KIND_CARDINALITY: return new Cardinality<DATA_TYPE>();
+    }
+    throw std::runtime_error("Unknown sketch kind " + std::to_string(kind));
+}
+
+template<typename DATA_TYPE>
+void SaveSketch(Abstract<DATA_TYPE>* sketch, const std::string& path){
+    Archive ar(path, Archive::SAVE);
+    ar.Header(sizeof(DATA_TYPE), sizeof(COUNT_TYPE));
+    sketch->Serialize(ar);
+}
+
+/*
+ * Read a snapshot into owned tables; the result accepts further inserts.
+ * A sketch whose Serialize throws part way is still safe to delete: its
+ * pointers start null and the tables it got so far are freed.
+ */
+template<typename DATA_TYPE>
+Abstract<DATA_TYPE>* LoadSketch(const std::string& path){
+    Archive ar(path, Archive::RESTORE);
+    ar.Header(sizeof(DATA_TYPE), sizeof(COUNT_TYPE));
+
+    std::unique_ptr<Abstract<DATA_TYPE>> sketch(NewSketch<DATA_TYPE>(ar.Peek()));
+    sketch->Serialize(ar);
+    return sketch.release();
+}
+
+/* Write only the non-empty slots, compressed for transfer */
+template<typename DATA_TYPE>
+void ExportSketch(Abstract<DATA_TYPE>* sketch, const std::string& path){
+    Archive ar(path, Archive::EXPORT);
+    ar.Header(sizeof(DATA_TYPE), sizeof(COUNT_TYPE));
+    sketch->Serialize(ar);
+}
+
+/* Rebuild a queryable sketch from ExportSketch output */
+template<typename DATA_TYPE>
+Abstract<DATA_TYPE>* ImportSketch(const std::string& path){
+    Archive ar(path, Archive::IMPORT);
+    ar.Header(sizeof(DATA_TYPE), sizeof(COUNT_TYPE));
+
+    std::unique_ptr<Abstract<DATA_TYPE>> sketch(NewSketch<DATA_TYPE>(ar.Peek()));
+    sketch->Serialize(ar);
+    return sketch.release();
+}
+
+/* Map a snapshot without copying the tables; the result is for queries only */
+template<typename DATA_TYPE>
+Abstract<DATA_TYPE>* OpenSketch(const std::string& path){
+    Archive ar(path, Archive::MAP);
+    ar.Header(sizeof(DATA_TYPE), sizeof(COUNT_TYPE));
+
+    std::unique_ptr<Abstract<DATA_TYPE>> sketch(NewSketch<DATA_TYPE>(ar.Peek()));
+    sketch->Serialize(ar);
+    sketch->snapshot = ar.Release();
+    return sketch.release();
+}
+
+#endif
@@ -15,18 +15,24 @@ public:
         summary = new StreamSummary<DATA_TYPE, COUNT_TYPE>(summary->Memory2Size(_MEMORY));
     }
 
+    SpaceSaving(){}
+
     ~SpaceSaving(){
         delete summary;
     }
 
     void Insert(const DATA_TYPE& item){
+        Insert(item, 1);
+    }
+
+    void Insert(const DATA_TYPE& item, COUNT_TYPE weight){
         if(summary->mp->Lookup(item))
-            summary->Add_Data(item);
+            summary->Add_Data(item, weight);
         else{
             if(summary->isFull())
-                summary->SS_Replace(item);
+                summary->SS_Replace(item, weight);
             else
-                summary->New_Data(item);
+                summary->New_Data(item, weight);
         }
     }
 
@@ -42,8 +48,21 @@ public:
         return summary->AllQuery();
     }
 
+    void Clear(){
+        summary->Clear();
+    }
+
+    void Serialize(Archive& ar){
+        ar.Section(KIND_SPACESAVING);
+        ar.String(this->name);
+
+        if(ar.Loading())
+            summary = new StreamSummary<DATA_TYPE, COUNT_TYPE>();
+        summary->Serialize(ar);
+    }
+
 private:
-    StreamSummary<DATA_TYPE, COUNT_TYPE>* summary;
+    StreamSummary<DATA_TYPE, COUNT_TYPE>* summary = nullptr;
 };
 
 #endif
\ No newline at end of file
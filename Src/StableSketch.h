@@ -4,7 +4,7 @@
 #include "Abstract.h"
 #include <limits>
 
-template<typename DATA_TYPE>
+template<typename DATA_TYPE, uint32_t HASH_NUM = 4>
 class StableSketch : public Abstract<DATA_TYPE> {
 public:
 
@@ -14,6 +14,12 @@ public:
         COUNT_TYPE stability;
         DATA_TYPE ID;
         COUNT_TYPE counter;
+
+        void Code(Archive& ar){
+            ar.Count(stability);
+            ar.Key(ID);
+            ar.Count(counter);
+        }
     };
 
     StableSketch(uint32_t _MEMORY, uint32_t _STAGE1_BIAS = 0, std::string _name = "StableSketch"){
@@ -28,28 +34,36 @@ public:
         }
     }
 
+    StableSketch(){}
+
     ~StableSketch(){
-        for(uint32_t i = 0; i < HASH_NUM; ++i)
-            delete [] sketch[i];
+        if(!this->mapped && sketch != nullptr){
+            for(uint32_t i = 0; i < HASH_NUM; ++i)
+                delete [] sketch[i];
+        }
         delete [] sketch;
     }
 
     void Insert(const DATA_TYPE& item) {
+        Insert(item, 1);
+    }
+
+    void Insert(const DATA_TYPE& item, COUNT_TYPE weight) {
         COUNT_TYPE min = std::numeric_limits<COUNT_TYPE>::max();
         int R = -1;
         int M = -1;
 
         for(uint32_t i = 0; i < HASH_NUM; ++i) {
-            uint32_t pos = hash(item, i) % LENGTH;   
-            if (sketch[i][pos].ID[0] == '\0') {
+            uint32_t pos = hash(item, i, this->seed) % LENGTH;   
+            if (sketch[i][pos].counter == 0) {
                 sketch[i][pos].ID = item;
                 sketch[i][pos].stability = 1;
-                sketch[i][pos].counter = 1;
+                sketch[i][pos].counter = weight;
                 return;
             }
             if (item == sketch[i][pos].ID) {
                 sketch[i][pos].stability++;
-                sketch[i][pos].counter++;
+                sketch[i][pos].counter += weight;
                 return;
             }
             else if (sketch[i][pos].counter < min) {
@@ -59,19 +73,25 @@ public:
             }
         }
 
-        int k = rand() % (int)((sketch[R][M].counter * sketch[R][M].stability) + 1.0) + 1.0;
-        if (k > sketch[R][M].counter * sketch[R][M].stability) {
-            if (--sketch[R][M].counter == 0) {
-                sketch[R][M].ID = item;
-                sketch[R][M].counter = 1;
-                sketch[R][M].stability = std::max(sketch[R][M].stability - 1, 0);
-            }
+        COUNT_TYPE counter = sketch[R][M].counter, stability = sketch[R][M].stability;
+        COUNT_TYPE left = Decay(counter, weight,
+            [&](COUNT_TYPE c) { return (double)c * stability + 1; },
+            [&]() {
+                int k = this->random() % (int)((counter * stability) + 1.0) + 1.0;
+                return k > counter * stability;
+            }, this->random);
+
+        sketch[R][M].counter = counter;
+        if (left > 0) {
+            sketch[R][M].ID = item;
+            sketch[R][M].counter = left;
+            sketch[R][M].stability = std::max(stability - 1, 0);
         }
     }
 
     COUNT_TYPE Query(const DATA_TYPE& item){
         for(uint32_t i = 0; i < HASH_NUM; ++i) {
-            uint32_t pos = hash(item, i) % LENGTH;
+            uint32_t pos = hash(item, i, this->seed) % LENGTH;
             if (sketch[i][pos].ID == item) {
                 return sketch[i][pos].counter;
             }
@@ -79,12 +99,44 @@ public:
         return 0;
     }
 
+    /*
+     * A group goes row by row, prefetching only for the keys not found yet,
+     * so no key hashes more rows than in Query
+     */
+    void QueryBatch(const DATA_TYPE* keys, COUNT_TYPE* out, size_t n){
+        constexpr uint32_t GROUP = Abstract<DATA_TYPE>::PREFETCH_SLOTS;
+        uint32_t pending[GROUP], positions[GROUP];
+
+        for(size_t begin = 0;begin < n;begin += GROUP){
+            uint32_t size = std::min<size_t>(GROUP, n - begin);
+            for(uint32_t k = 0;k < size;++k){
+                pending[k] = k;
+                out[begin + k] = 0;
+            }
+            for(uint32_t i = 0;i < HASH_NUM && size > 0;++i){
+                HashBatch(keys + begin, pending, size, i, this->seed, positions);
+                for(uint32_t k = 0;k < size;++k){
+                    positions[k] %= LENGTH;
+                    Prefetch(&sketch[i][positions[k]]);
+                }
+                uint32_t left = 0;
+                for(uint32_t k = 0;k < size;++k){
+                    if(sketch[i][positions[k]].ID == keys[begin + pending[k]])
+                        out[begin + pending[k]] = sketch[i][positions[k]].counter;
+                    else
+                        pending[left++] = pending[k];
+                }
+                size = left;
+            }
+        }
+    }
+
     HashMap AllQuery(){
         HashMap ret;
 
         for(uint32_t i = 0; i < HASH_NUM; ++i){
             for (uint32_t j = 0; j < LENGTH; ++j) {
-                if (sketch[i][j].ID[0] != '\0' && ret.find(sketch[i][j].ID) == ret.end()) {
+                if (sketch[i][j].counter != 0 && ret.find(sketch[i][j].ID) == ret.end()) {
                     ret[sketch[i][j].ID] = Query(sketch[i][j].ID) + this->stage1_bias;
                 }
             }
@@ -93,12 +145,32 @@ public:
         return ret;
     }
 
+    void Clear(){
+        for(uint32_t i = 0; i < HASH_NUM; ++i)
+            memset(sketch[i], 0, sizeof(Bucket) * LENGTH);
+    }
+
+    void Serialize(Archive& ar){
+        ar.Section(KIND_STABLESKETCH);
+        ar.Attach(this->mapped);
+        ar.String(this->name);
+        ar.Param(HASH_NUM);
+        ar.Value(this->stage1_bias);
+        ar.Value(this->seed);
+        ar.Value(this->random);
+        ar.Value(LENGTH);
+
+        if(ar.Loading())
+            sketch = new Bucket* [HASH_NUM]();
+        for(uint32_t i = 0; i < HASH_NUM; ++i)
+            ar.Array(sketch[i], LENGTH);
+    }
+
 private:
 
     uint32_t LENGTH;
-    const uint32_t HASH_NUM = 4;
 
-    Bucket** sketch;
+    Bucket** sketch = nullptr;
 };
 
 #endif
\ No newline at end of file
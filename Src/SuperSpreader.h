@@ -0,0 +1,152 @@
+#ifndef SUPERSPREADER_H
+#define SUPERSPREADER_H
+
+#include "Abstract.h"
+#include "BitMap.h"
+#include "HyperLogLog.h"
+#include <limits>
+
+/*
+ * Sources contacting many distinct destinations (dstIP, dstPort), e.g. scans.
+ * A bitmap over (source, destination) pairs lets only the first packet of a
+ * pair through, so a source's count of such packets is its fan-out and the
+ * buckets keep candidate sources by it, with OurSketch's replacement. Each
+ * tracked source carries REGISTERS HyperLogLog registers of its destinations,
+ * updated by all of its packets, so a pair lost to a bitmap collision is still
+ * counted; a source's fan-out is their estimate since it took its slot.
+ */
+class SuperSpreader{
+public:
+    typedef std::unordered_map<SRC_IP, COUNT_TYPE> HashMap;
+    static constexpr uint32_t COUNTER_PER_BUCKET = 4;
+    static constexpr uint32_t PRECISION = 5;
+    static constexpr uint32_t REGISTERS = 1u << PRECISION;
+
+    struct Bucket{
+        SRC_IP ID[COUNTER_PER_BUCKET];
+        COUNT_TYPE count[COUNTER_PER_BUCKET];
+        uint8_t registers[COUNTER_PER_BUCKET][REGISTERS];
+    };
+
+    /* _FILTER_RATIO of _MEMORY goes to the pair bitmap, the rest to the buckets */
+    SuperSpreader(uint32_t _MEMORY, double _FILTER_RATIO = 0.5){
+        if(_FILTER_RATIO <= 0 || _FILTER_RATIO >= 1)
+            throw std::invalid_argument("SuperSpreader filter ratio must be between 0 and 1");
+
+        FILTER_LENGTH = _MEMORY * _FILTER_RATIO * 8;
+        LENGTH = _MEMORY * (1 - _FILTER_RATIO) / sizeof(Bucket);
+        if(FILTER_LENGTH == 0 || LENGTH == 0)
+            throw std::invalid_argument("SuperSpreader needs at least one bucket and one filter bit");
+
+        filter = new BitMap(FILTER_LENGTH);
+        buckets = new Bucket[LENGTH];
+        name = "SuperSpreader";
+        Clear();
+    }
+
+    ~SuperSpreader(){
+        delete filter;
+        delete [] buckets;
+    }
+
+    std::string name;
+
+    void Insert(const TUPLES& item){
+        SRC_IP src = item.srcIP();
+        uint64_t destination = ((uint64_t)item.dstIP() << 16) | item.dstPort();
+
+        uint32_t hashed = hash(src, 0, seed);
+        uint64_t code = hash64(destination, 0, seed);
+        uint32_t index = (code ^ ((uint64_t)hashed * 0x9e3779b97f4a7c15ULL)) % FILTER_LENGTH;
+        bool fresh = !filter->Get(index);
+        filter->Set(index);
+
+        Bucket& bucket = buckets[hashed % LENGTH];
+        int32_t minPos = -1;
+        COUNT_TYPE minVal = std::numeric_limits<COUNT_TYPE>::max();
+
+        for(uint32_t i = 0;i < COUNTER_PER_BUCKET;++i){
+            if(bucket.count[i] != 0 && bucket.ID[i] == src){
+                bucket.count[i] += fresh;
+                HyperLogLog::Insert(bucket.registers[i], PRECISION, code);
+                return;
+            }
+        }
+        if(!fresh)
+            return;
+
+        for(uint32_t i = 0;i < COUNTER_PER_BUCKET;++i){
+            if(bucket.count[i] == 0){
+                Take(bucket, i, src, code);
+                return;
+            }
+            if(bucket.count[i] < minVal){
+                minVal = bucket.count[i];
+                minPos = i;
+            }
+        }
+
+        bucket.count[minPos] += 1;
+        if(random() % bucket.count[minPos] == 0)
+            Take(bucket, minPos, src, code);
+    }
+
+    /* Estimated distinct destinations of src, 0 if it is not tracked */
+    COUNT_TYPE Query(SRC_IP src){
+        Bucket& bucket = buckets[hash(src, 0, seed) % LENGTH];
+        for(uint32_t i = 0;i < COUNTER_PER_BUCKET;++i){
+            if(bucket.count[i] != 0 && bucket.ID[i] == src)
+                return Estimate(bucket, i);
+        }
+        return 0;
+    }
+
+    /* Every tracked source with its estimated fan-out */
+    HashMap AllQuery(){
+        HashMap ret;
+        for(uint32_t i = 0;i < LENGTH;++i){
+            for(uint32_t j = 0;j < COUNTER_PER_BUCKET;++j){
+                if(buckets[i].count[j] != 0)
+                    ret[buckets[i].ID[j]] = Estimate(buckets[i], j);
+            }
+        }
+        return ret;
+    }
+
+    /* Hashes and the replacement stream; set before the first Insert */
+    void Seed(uint32_t _seed){
+        seed = _seed;
+        random.Seed(_seed);
+    }
+
+    void Clear(){
+        filter->Clear();
+        memset(buckets, 0, sizeof(Bucket) * LENGTH);
+    }
+
+private:
+    uint32_t seed = 0;
+    Random random;
+
+    uint32_t FILTER_LENGTH;
+    uint32_t LENGTH;
+    BitMap* filter;
+    Bucket* buckets;
+
+    inline void Take(Bucket& bucket, uint32_t pos, SRC_IP src, uint64_t code){
+        bucket.ID[pos] = src;
+        bucket.count[pos] = 1;
+        memset(bucket.registers[pos], 0, REGISTERS);
+        HyperLogLog::Insert(bucket.registers[pos], PRECISION, code);
+    }
+
+    inline COUNT_TYPE Estimate(const Bucket& bucket, uint32_t pos) const{
+        return std::round(HyperLogLog::Estimate(bucket.registers[pos], REGISTERS));
+    }
+};
+
+constexpr uint32_t SuperSpreader::COUNTER_PER_BUCKET;
+constexpr uint32_t SuperSpreader::PRECISION;
+constexpr uint32_t SuperSpreader::REGISTERS;
+
+#endif
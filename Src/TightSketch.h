@@ -4,7 +4,7 @@
 #include "Abstract.h"
 #include <limits>
 
-template<typename DATA_TYPE>
+template<typename DATA_TYPE, uint32_t HASH_NUM = 4, uint32_t DECAY_THRESHOLD = 10>
 class TightSketch : public Abstract<DATA_TYPE> {
 public:
 
@@ -14,6 +14,12 @@ public:
         COUNT_TYPE arrival_strength;
         DATA_TYPE ID;
         COUNT_TYPE counter;
+
+        void Code(Archive& ar){
+            ar.Count(arrival_strength);
+            ar.Key(ID);
+            ar.Count(counter);
+        }
     };
 
     TightSketch(uint32_t _MEMORY, uint32_t _STAGE1_BIAS = 0, std::string _name = "TightSketch"){
@@ -28,28 +34,36 @@ public:
         }
     }
 
+    TightSketch(){}
+
     ~TightSketch(){
-        for(uint32_t i = 0; i < HASH_NUM; ++i)
-            delete [] sketch[i];
+        if(!this->mapped && sketch != nullptr){
+            for(uint32_t i = 0; i < HASH_NUM; ++i)
+                delete [] sketch[i];
+        }
         delete [] sketch;
     }
 
     void Insert(const DATA_TYPE& item) {
+        Insert(item, 1);
+    }
+
+    void Insert(const DATA_TYPE& item, COUNT_TYPE weight) {
         COUNT_TYPE min = std::numeric_limits<COUNT_TYPE>::max();
         int R = -1;
         int M = -1;
 
         for(uint32_t i = 0; i < HASH_NUM; ++i) {
-            uint32_t pos = hash(item, i) % LENGTH;   
-            if (sketch[i][pos].ID[0] == '\0') {
+            uint32_t pos = hash(item, i, this->seed) % LENGTH;   
+            if (sketch[i][pos].counter == 0) {
                 sketch[i][pos].ID = item;
                 sketch[i][pos].arrival_strength = 1;
-                sketch[i][pos].counter = 1;
+                sketch[i][pos].counter = weight;
                 return;
             }
             if (item == sketch[i][pos].ID) {
                 sketch[i][pos].arrival_strength++;
-                sketch[i][pos].counter++;
+                sketch[i][pos].counter += weight;
                 return;
             }
             else if (sketch[i][pos].counter < min) {
@@ -60,26 +74,26 @@ public:
             sketch[i][pos].arrival_strength = std::max(0, sketch[i][pos].arrival_strength - 1);
         }
 
-        if (sketch[R][M].counter < DECAY_THRESHOLD) {
-            if (rand() % (sketch[R][M].counter + 1) == 0) {
-                sketch[R][M].counter--;
-            }
-        }
-        else {
-            if (rand() % (sketch[R][M].counter * sketch[R][M].arrival_strength + 1) == 0) {
-                sketch[R][M].counter--;
-            }
-        }
-
-        if (sketch[R][M].counter == 0) {
+        COUNT_TYPE counter = sketch[R][M].counter, strength = sketch[R][M].arrival_strength;
+        auto period = [&](COUNT_TYPE c) {
+            return (c < (COUNT_TYPE)DECAY_THRESHOLD) ? (double)c + 1 : (double)c * strength + 1;
+        };
+        COUNT_TYPE left = Decay(counter, weight, period, [&]() {
+            if (counter < (COUNT_TYPE)DECAY_THRESHOLD)
+                return this->random() % (counter + 1) == 0;
+            return this->random() % (counter * strength + 1) == 0;
+        }, this->random);
+
+        sketch[R][M].counter = counter;
+        if (left > 0) {
             sketch[R][M].ID = item;
-            sketch[R][M].counter = 1;            
+            sketch[R][M].counter = left;
         }
     }
 
     COUNT_TYPE Query(const DATA_TYPE& item){
         for(uint32_t i = 0; i < HASH_NUM; ++i) {
-            uint32_t pos = hash(item, i) % LENGTH;
+            uint32_t pos = hash(item, i, this->seed) % LENGTH;
             if (sketch[i][pos].ID == item) {
                 return sketch[i][pos].counter;
             }
@@ -87,12 +101,44 @@ public:
         return 0;
     }
 
+    /*
+     * A group goes row by row, prefetching only for the keys not found yet,
+     * so no key hashes more rows than in Query
+     */
+    void QueryBatch(const DATA_TYPE* keys, COUNT_TYPE* out, size_t n){
+        constexpr uint32_t GROUP = Abstract<DATA_TYPE>::PREFETCH_SLOTS;
+        uint32_t pending[GROUP], positions[GROUP];
+
+        for(size_t begin = 0;begin < n;begin += GROUP){
+            uint32_t size = std::min<size_t>(GROUP, n - begin);
+            for(uint32_t k = 0;k < size;++k){
+                pending[k] = k;
+                out[begin + k] = 0;
+            }
+            for(uint32_t i = 0;i < HASH_NUM && size > 0;++i){
+                HashBatch(keys + begin, pending, size, i, this->seed, positions);
+                for(uint32_t k = 0;k < size;++k){
+                    positions[k] %= LENGTH;
+                    Prefetch(&sketch[i][positions[k]]);
+                }
+                uint32_t left = 0;
+                for(uint32_t k = 0;k < size;++k){
+                    if(sketch[i][positions[k]].ID == keys[begin + pending[k]])
+                        out[begin + pending[k]] = sketch[i][positions[k]].counter;
+                    else
+                        pending[left++] = pending[k];
+                }
+                size = left;
+            }
+        }
+    }
+
     HashMap AllQuery(){
         HashMap ret;
 
         for(uint32_t i = 0; i < HASH_NUM; ++i){
             for (uint32_t j = 0; j < LENGTH; ++j) {
-                if (sketch[i][j].ID[0] != '\0' && ret.find(sketch[i][j].ID) == ret.end()) {
+                if (sketch[i][j].counter != 0 && ret.find(sketch[i][j].ID) == ret.end()) {
                     ret[sketch[i][j].ID] = Query(sketch[i][j].ID) + this->stage1_bias;
                 }
             }
@@ -101,14 +147,33 @@ public:
         return ret;
     }
 
+    void Clear(){
+        for(uint32_t i = 0; i < HASH_NUM; ++i)
+            memset(sketch[i], 0, sizeof(Bucket) * LENGTH);
+    }
+
+    void Serialize(Archive& ar){
+        ar.Section(KIND_TIGHTSKETCH);
+        ar.Attach(this->mapped);
+        ar.String(this->name);
+        ar.Param(HASH_NUM);
+        ar.Param(DECAY_THRESHOLD);
+        ar.Value(this->stage1_bias);
+        ar.Value(this->seed);
+        ar.Value(this->random);
+        ar.Value(LENGTH);
+
+        if(ar.Loading())
+            sketch = new Bucket* [HASH_NUM]();
+        for(uint32_t i = 0; i < HASH_NUM; ++i)
+            ar.Array(sketch[i], LENGTH);
+    }
+
 private:
 
     uint32_t LENGTH;
-    const uint32_t HASH_NUM = 4;
-
-    const uint32_t DECAY_THRESHOLD = 10;
 
-    Bucket** sketch;
+    Bucket** sketch = nullptr;
 };
 
 #endif
\ No newline at end of file
@@ -23,6 +23,14 @@ public:
             }
             return 0;
         }
+
+        void Code(Archive& ar) {
+            ar.Count(vote);
+            for(uint32_t i = 0; i < COUNTER_PER_BUCKET; i++) {
+                ar.Key(ID[i]);
+                ar.Count(count[i]);
+            }
+        }
     };
 
     TwoFASketch(uint32_t _MEMORY, uint32_t _THRESHOLD = 3216, uint32_t _STAGE1_BIAS = 0, std::string _name = "TwoFASketch"){
@@ -37,23 +45,30 @@ public:
         memset(buckets, 0, sizeof(Bucket) * LENGTH);
     }
 
+    TwoFASketch(){}
+
     ~TwoFASketch(){
-        delete [] buckets;
+        if(!this->mapped)
+            delete [] buckets;
     }
 
     void Insert(const DATA_TYPE& item) {
-        uint32_t pos = hash(item) % LENGTH, minPos = 0;
+        Insert(item, 1);
+    }
+
+    void Insert(const DATA_TYPE& item, COUNT_TYPE weight) {
+        uint32_t pos = hash(item, 0, this->seed) % LENGTH, minPos = 0;
         COUNT_TYPE minVal = std::numeric_limits<COUNT_TYPE>::max();
 
         for (uint32_t i = 0; i < COUNTER_PER_BUCKET; i++){
             if(buckets[pos].ID[i] == item){
-                buckets[pos].count[i] += 1;
+                buckets[pos].count[i] += weight;
                 return;
             }
 
             if(buckets[pos].count[i] == 0){
                 buckets[pos].ID[i] = item;
-                buckets[pos].count[i] = 1;
+                buckets[pos].count[i] = weight;
                 return;
             }
 
@@ -63,18 +78,18 @@ public:
             }
         }
 
-        if(minVal >= THRESHOLD / 2){
-            pos = hash(item, 101) % LENGTH, minPos = 0;
+        if(minVal >= (COUNT_TYPE)(THRESHOLD / 2)){
+            pos = hash(item, 101, this->seed) % LENGTH, minPos = 0;
             minVal = std::numeric_limits<COUNT_TYPE>::max();
             for (uint32_t i = 0; i < COUNTER_PER_BUCKET; i++){
                 if(buckets[pos].ID[i] == item){
-                    buckets[pos].count[i] += 1;
+                    buckets[pos].count[i] += weight;
                     return;
                 }
     
                 if(buckets[pos].count[i] == 0){
                     buckets[pos].ID[i] = item;
-                    buckets[pos].count[i] = 1;
+                    buckets[pos].count[i] = weight;
                     return;
                 }
     
@@ -83,7 +98,7 @@ public:
                     minVal = buckets[pos].count[i];
                 }
             }
-            buckets[pos].vote += 1;
+            buckets[pos].vote += weight;
             if (buckets[pos].vote >= minVal) {
                 buckets[pos].count[minPos] = buckets[pos].vote;
                 buckets[pos].ID[minPos] = item;
@@ -91,7 +106,7 @@ public:
             }
         }
         else {
-            buckets[pos].vote += 1;
+            buckets[pos].vote += weight;
             if (buckets[pos].vote >= minVal) {
                 buckets[pos].count[minPos] = buckets[pos].vote;
                 buckets[pos].ID[minPos] = item;
@@ -101,14 +116,30 @@ public:
     }
 
     COUNT_TYPE Query(const DATA_TYPE& item){
-        return buckets[hash(item) % LENGTH].Query(item) + this->stage1_bias;
+        return buckets[hash(item, 0, this->seed) % LENGTH].Query(item) + this->stage1_bias;
+    }
+
+    void QueryBatch(const DATA_TYPE* keys, COUNT_TYPE* out, size_t n){
+        constexpr uint32_t GROUP = Abstract<DATA_TYPE>::PREFETCH_SLOTS;
+        uint32_t positions[GROUP];
+
+        for(size_t begin = 0;begin < n;begin += GROUP){
+            uint32_t size = std::min<size_t>(GROUP, n - begin);
+            HashBatch(keys + begin, (const uint32_t*)nullptr, size, 0, this->seed, positions);
+            for(uint32_t k = 0;k < size;++k){
+                positions[k] %= LENGTH;
+                Prefetch(&buckets[positions[k]]);
+            }
+            for(uint32_t k = 0;k < size;++k)
+                out[begin + k] = buckets[positions[k]].Query(keys[begin + k]) + this->stage1_bias;
+        }
     }
 
     HashMap AllQuery(){
         HashMap ret;
         for(uint32_t i = 0;i < LENGTH;++i){
             for(uint32_t j = 0;j < COUNTER_PER_BUCKET;++j){
-                if (buckets[i].ID[j][0] != '\0') {
+                if (buckets[i].count[j] != 0) {
                     ret[buckets[i].ID[j]] = buckets[i].count[j] + this->stage1_bias;
                 }
             }
@@ -116,10 +147,27 @@ public:
         return ret;
     }
 
+    void Clear(){
+        memset(buckets, 0, sizeof(Bucket) * LENGTH);
+    }
+
+    void Serialize(Archive& ar){
+        ar.Section(KIND_TWOFASKETCH);
+        ar.Attach(this->mapped);
+        ar.String(this->name);
+        ar.Param(COUNTER_PER_BUCKET);
+        ar.Value(THRESHOLD);
+        ar.Value(this->stage1_bias);
+        ar.Value(this->seed);
+        ar.Value(this->random);
+        ar.Value(LENGTH);
+        ar.Array(buckets, LENGTH);
+    }
+
 private:
     uint32_t LENGTH;
     uint32_t THRESHOLD;
-    Bucket* buckets;
+    Bucket* buckets = nullptr;
 };
 
 #endif
\ No newline at end of file
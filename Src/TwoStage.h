@@ -27,7 +27,15 @@ class TwoStage : public Abstract<DATA_TYPE>{
 public:
     typedef std::unordered_map<DATA_TYPE, COUNT_TYPE> HashMap;
     
-    TwoStage(uint32_t _MEMORY, uint32_t _THRESHOLD){
+    /* _FILTER_RATIO of the memory goes to the filter; a flow passes it at _STAGE1_THRESHOLD_RATIO x _THRESHOLD */
+    TwoStage(uint32_t _MEMORY, uint32_t _THRESHOLD, double _FILTER_RATIO = 0.5, double _STAGE1_THRESHOLD_RATIO = 0.5){
+        if(_FILTER_RATIO <= 0 || _FILTER_RATIO >= 1)
+            throw std::invalid_argument("TwoStage filter ratio must be in (0, 1)");
+
+        FILTER_RATIO = _FILTER_RATIO;
+        SKETCH_RATIO = 1 - _FILTER_RATIO;
+        STAGE1_TRESHOLD_RATIO = _STAGE1_THRESHOLD_RATIO;
+
         uint32_t FILTER_MEMORY = _MEMORY * FILTER_RATIO;
         uint32_t SKETCH_MEMORY = _MEMORY * SKETCH_RATIO;
         STAGE1_THRESHOLD = _THRESHOLD * STAGE1_TRESHOLD_RATIO;
@@ -40,14 +48,22 @@ public:
         this->name = "TwoStage ( " + filter->name + " + " + sketch->name + " )";
     }
 
+    TwoStage(){}
+
     ~TwoStage(){
         delete filter;
         delete sketch;
     }
 
     void Insert(const DATA_TYPE& item){
-        if (filter->Insert(item) >= STAGE1_THRESHOLD) {
-            sketch->Insert(item);
+        Insert(item, 1);
+    }
+
+    /* Only the units that arrive once the filter has reached the threshold go to the sketch */
+    void Insert(const DATA_TYPE& item, COUNT_TYPE weight){
+        int64_t passed = (int64_t)filter->Insert(item, weight) - STAGE1_THRESHOLD + 1;
+        if (passed > 0) {
+            sketch->Insert(item, std::min<int64_t>(passed, weight));
         }
     }
 
@@ -62,19 +78,47 @@ public:
     HashMap AllQuery(){
         return sketch->AllQuery();
     }
+
+    void Seed(uint32_t _seed){
+        Abstract<DATA_TYPE>::Seed(_seed);
+        filter->Seed(_seed);
+        sketch->Seed(_seed);
+    }
+
+    void Clear(){
+        filter->Clear();
+        sketch->Clear();
+    }
     
+    void Serialize(Archive& ar){
+        ar.Section(KIND_TWOSTAGE);
+        ar.String(this->name);
+        ar.Value(this->seed);
+        ar.Value(FILTER_RATIO);
+        ar.Value(SKETCH_RATIO);
+        ar.Value(STAGE1_TRESHOLD_RATIO);
+        ar.Value(STAGE1_THRESHOLD);
+
+        if(ar.Loading()){
+            filter = new CountingBloomFilter<DATA_TYPE, COUNT_TYPE>();
+            sketch = new Stage2SketchType<DATA_TYPE>();
+        }
+        filter->Serialize(ar);
+        sketch->Serialize(ar);
+    }
+
 private:
-    const double FILTER_RATIO = 0.5;
-    const double SKETCH_RATIO = 0.5;
+    double FILTER_RATIO;
+    double SKETCH_RATIO;
 
     COUNT_TYPE STAGE1_THRESHOLD;
     // COUNT_TYPE STAGE2_THRESHOLD;
 
-    const double STAGE1_TRESHOLD_RATIO = 0.5;
+    double STAGE1_TRESHOLD_RATIO;
     // const double STAGE2_TRESHOLD_RATIO = 0.2;
 
-    CountingBloomFilter<DATA_TYPE, COUNT_TYPE>* filter;
-    Stage2SketchType<DATA_TYPE>* sketch;
+    CountingBloomFilter<DATA_TYPE, COUNT_TYPE>* filter = nullptr;
+    Stage2SketchType<DATA_TYPE>* sketch = nullptr;
 };
 
 #endif
\ No newline at end of file
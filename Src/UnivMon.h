@@ -2,80 +2,296 @@
 #define UNIVMON_H
 
 #include "Abstract.h"
-#include "CountHeap.h"
+#include "Heap.h"
+#include "HyperLogLog.h"
 
+/*
+ * LEVEL Count sketches with heaps, level l seeing a 2^-l sample of the flows.
+ * One 64-bit hash per packet gives both the sampling and the row indices of
+ * every level (double hashing), so an update walks its levels in one pass.
+ * GSum estimates sum g(f) over all flows from the level heaps alone, which is
+ * sound once the last level's heap holds every flow sampled into it: given
+ * _FLOWS, the expected number of distinct flows, LEVEL is the smallest count
+ * that achieves this, about log2 of _FLOWS over the heap size, and level 0
+ * takes half the memory while the other levels share the rest. Without it
+ * there are DEFAULT_LEVEL levels, each with half the memory of the one before,
+ * which favours the heavy hitters. With _DISTINCT_MEMORY, a HyperLogLog fed
+ * with the same hash counts the distinct flows, in addition to the sketch memory.
+ */
 template<typename DATA_TYPE>
 class UnivMon : public Abstract<DATA_TYPE>{
 public:
     typedef std::unordered_map<DATA_TYPE, COUNT_TYPE> HashMap;
-    
-    UnivMon(uint32_t _MEMORY, std::string _name = "UnivMon"){
+    static constexpr uint32_t DEFAULT_LEVEL = 6;
+    static constexpr uint32_t MAX_LEVEL = 25;
+    static constexpr uint32_t HASH_NUM = 3;
+
+    UnivMon(uint32_t _MEMORY, std::string _name = "UnivMon", uint32_t _DISTINCT_MEMORY = 0, uint64_t _FLOWS = 0){
         this->name = _name;
+        counter = _DISTINCT_MEMORY ? new HyperLogLog(_DISTINCT_MEMORY) : nullptr;
 
-        sketches = new CountHeap<DATA_TYPE>* [LEVEL];
+        LEVEL = DEFAULT_LEVEL;
+        if(_FLOWS){
+            LEVEL = 2;
+            while(LEVEL < MAX_LEVEL && (_FLOWS >> (LEVEL - 1)) > HeapSize(_MEMORY, LEVEL))
+                LEVEL += 1;
+        }
 
-        for(uint32_t i = 0;i < LEVEL; ++i){
-            sketches[i] = new CountHeap<DATA_TYPE>(_MEMORY >> (i + 1));
+        LENGTH = new uint32_t [LEVEL];
+        counters = new COUNT_TYPE* [LEVEL];
+        heaps = new Heap<DATA_TYPE, COUNT_TYPE>* [LEVEL];
+        for(uint32_t i = 0;i < LEVEL;++i){
+            uint32_t LEVEL_MEMORY = _FLOWS ? LevelMemory(_MEMORY, LEVEL, i) : (_MEMORY >> (i + 1));
+            LENGTH[i] = LEVEL_MEMORY * LIGHT_RATIO / HASH_NUM / sizeof(COUNT_TYPE);
+            counters[i] = new COUNT_TYPE [HASH_NUM * LENGTH[i]];
+            heaps[i] = new Heap<DATA_TYPE, COUNT_TYPE>(Heap<DATA_TYPE, COUNT_TYPE>::Memory2Size(LEVEL_MEMORY * HEAVY_RATIO));
         }
+        Clear();
     }
 
+    UnivMon(){}
+
     ~UnivMon(){
-        for(uint32_t i = 0;i < LEVEL;++i){
-            delete sketches[i];
+        for(uint32_t i = 0;counters != nullptr && heaps != nullptr && i < LEVEL;++i){
+            if(!this->mapped)
+                delete [] counters[i];
+            delete heaps[i];
         }
-        delete [] sketches;
+        delete [] LENGTH;
+        delete [] counters;
+        delete [] heaps;
+        delete counter;
     }
 
     void Insert(const DATA_TYPE& item){
-        uint32_t pos = hash(item, 199);
-        sketches[0]->Insert(item);
-        for(uint32_t i = 1; i < LEVEL; ++i){
-            if(pos & 1)
-                sketches[i]->Insert(item);
-            else
-                break;
-            pos >>= 1;
+        Insert(item, 1);
+    }
+
+    void Insert(const DATA_TYPE& item, COUNT_TYPE weight){
+        uint64_t hashed = hash64(item, HASH_SEED, this->seed);
+        Code code(hashed, LEVEL);
+
+        if(counter)
+            counter->Insert(hashed);
+        total += weight;
+        for(uint32_t i = 0;i < code.levels;++i){
+            COUNT_TYPE result[HASH_NUM];
+            for(uint32_t j = 0;j < HASH_NUM;++j){
+                COUNT_TYPE& counter = counters[i][j * LENGTH[i] + code.Position(j, LENGTH[i])];
+                counter += code.Sign(j) * weight;
+                result[j] = counter * code.Sign(j);
+            }
+            heaps[i]->Insert(item, Median<HASH_NUM>(result), weight);
         }
     }
 
     COUNT_TYPE Query(const DATA_TYPE& item){
-        uint32_t pos = hash(item, 199);
-        int32_t level;
-
-        for(level = 1; level < LEVEL; ++level){
-            if(pos & 1)
-                pos >>= 1;
-            else
-                break;
-        }
+        Code code(hash64(item, HASH_SEED, this->seed), LEVEL);
+        return Recursion(code, [&](uint32_t level) { return heaps[level]->Query(item); });
+    }
+
+    /* Every tracked flow, with its heap counts taken from one pass over the heaps */
+    HashMap AllQuery(){
+        HashMap ret;
+        std::vector<HashMap> tracked(LEVEL);
+        for(uint32_t i = 0;i < LEVEL;++i)
+            tracked[i] = heaps[i]->AllQuery();
 
-        COUNT_TYPE ret = sketches[level - 1]->Query(item);
-        for(int32_t i = level - 2;i >= 0;--i){
-            ret = 2 * ret - sketches[i]->Query(item);
+        for(uint32_t i = 0;i < LEVEL;++i){
+            for(auto it = tracked[i].begin();it != tracked[i].end();++it){
+                if(ret.find(it->first) != ret.end())
+                    continue;
+                Code code(hash64(it->first, HASH_SEED, this->seed), LEVEL);
+                ret[it->first] = Recursion(code, [&](uint32_t level) -> COUNT_TYPE {
+                    if(level == i)
+                        return it->second;
+                    auto find = tracked[level].find(it->first);
+                    return (find == tracked[level].end()) ? 0 : find->second;
+                });
+            }
         }
 
         return ret;
     }
 
-    HashMap AllQuery(){
-        HashMap ret, hhSet;
+    /*
+     * Estimate of the sum of g(f) over every flow, by the UnivMon recursion
+     * Y_l = 2 Y_(l+1) + sum over the heap of level l of (1 - 2 [sampled at l+1]) g(f),
+     * starting from the plain sum at the last level. Needs g(0) = 0.
+     */
+    double GSum(const std::function<double(double)>& g){
+        double ret = 0;
 
-        for(uint32_t i = 0;i < LEVEL;++i){
-            HashMap temp = sketches[i]->AllQuery();
+        for(int32_t i = LEVEL - 1;i >= 0;--i){
+            double sum = 0;
+            HashMap temp = heaps[i]->AllQuery();
             for(auto it = temp.begin();it != temp.end();++it){
-                if(hhSet.find(it->first) == hhSet.end()){
-                    hhSet[it->first] = it->second;
-                    ret[it->first] = Query(it->first);
-                }
+                if(it->second <= 0)
+                    continue;
+                double value = g(it->second);
+                if(i + 1 < (int32_t)LEVEL && Code(hash64(it->first, HASH_SEED, this->seed), LEVEL).levels > (uint32_t)i + 1)
+                    sum -= value;
+                else
+                    sum += value;
             }
+            ret = 2 * ret + sum;
         }
 
         return ret;
     }
 
+    inline uint32_t Levels() const{
+        return LEVEL;
+    }
+
+    /* Second frequency moment */
+    double F2(){
+        return GSum([](double f) { return f * f; });
+    }
+
+    /*
+     * Number of distinct flows, from the HyperLogLog if there is one; the G-sum
+     * estimate is low unless LEVEL was sized for at least as many _FLOWS
+     */
+    double Distinct(){
+        if(counter)
+            return counter->Estimate();
+        return GSum([](double) { return 1.0; });
+    }
+
+    /* Empirical entropy in bits of the flow size distribution; the packet total is exact */
+    double Entropy(){
+        if(total == 0)
+            return 0;
+        double sum = GSum([](double f) { return f * std::log2(f); });
+        return std::log2((double)total) - sum / total;
+    }
+
+    void Clear(){
+        for(uint32_t i = 0;i < LEVEL;++i){
+            memset(counters[i], 0, sizeof(COUNT_TYPE) * HASH_NUM * LENGTH[i]);
+            heaps[i]->Clear();
+        }
+        if(counter)
+            counter->Clear();
+        total = 0;
+    }
+
+    void Serialize(Archive& ar){
+        ar.Section(KIND_UNIVMON);
+        ar.Attach(this->mapped);
+        ar.String(this->name);
+        ar.Value(this->seed);
+        ar.Value(LEVEL);
+        ar.Param(HASH_NUM);
+        ar.Value(total);
+
+        if(ar.Loading()){
+            LENGTH = new uint32_t [LEVEL];
+            counters = new COUNT_TYPE* [LEVEL]();
+            heaps = new Heap<DATA_TYPE, COUNT_TYPE>* [LEVEL]();
+        }
+        for(uint32_t i = 0;i < LEVEL;++i){
+            ar.Value(LENGTH[i]);
+            ar.Array(counters[i], HASH_NUM * LENGTH[i]);
+            if(ar.Loading())
+                heaps[i] = new Heap<DATA_TYPE, COUNT_TYPE>();
+            heaps[i]->Serialize(ar);
+        }
+
+        bool distinct = (counter != nullptr);
+        ar.Value(distinct);
+        if(ar.Loading())
+            counter = distinct ? new HyperLogLog() : nullptr;
+        if(distinct)
+            counter->Serialize(ar);
+    }
+
 private:
-    const uint32_t LEVEL = 6;
-    CountHeap<DATA_TYPE>** sketches;
+    static constexpr uint32_t HASH_SEED = 199;
+    static constexpr double HEAVY_RATIO = 0.25;
+    static constexpr double LIGHT_RATIO = 0.75;
+
+    /*
+     * What one packet needs from its 64-bit hash: the low and high words step
+     * through the rows, and a multiplicative remix gives the signs and the
+     * sampling, so they do not follow the row indices.
+     */
+    struct Code{
+        uint32_t first, step, mixed, levels;
+
+        Code(uint64_t code, uint32_t _LEVEL){
+            first = code;
+            step = (code >> 32) | 1;
+            uint64_t remix = code * 0x9e3779b97f4a7c15ULL;
+            mixed = remix >> 32;
+            levels = std::min<uint32_t>(__builtin_ctz(~(uint32_t)(remix >> 8) | (1u << 24)) + 1, _LEVEL);
+        }
+
+        inline uint32_t Position(uint32_t row, uint32_t length) const{
+            return (first + row * step) % length;
+        }
+
+        inline COUNT_TYPE Sign(uint32_t row) const{
+            return ((mixed >> row) & 1) ? -1 : 1;
+        }
+    };
+
+    uint32_t LEVEL;
+    uint32_t* LENGTH = nullptr;
+    COUNT_TYPE** counters = nullptr;
+    Heap<DATA_TYPE, COUNT_TYPE>** heaps = nullptr;
+    HyperLogLog* counter = nullptr;
+    int64_t total;
+
+    /* Memory of a level when LEVEL is sized for the flows */
+    static uint32_t LevelMemory(uint32_t _MEMORY, uint32_t _LEVEL, uint32_t level){
+        return (level == 0) ? _MEMORY / 2 : _MEMORY / 2 / (_LEVEL - 1);
+    }
+
+    /* Flows the heap of each level past the first holds, when sized */
+    static uint32_t HeapSize(uint32_t _MEMORY, uint32_t _LEVEL){
+        return Heap<DATA_TYPE, COUNT_TYPE>::Memory2Size(LevelMemory(_MEMORY, _LEVEL, 1) * HEAVY_RATIO);
+    }
+
+    /*
+     * The estimate from the deepest level the flow is sampled into up to level
+     * 0, Y_l = 2 Y_(l+1) - Y'_l, where heapCount(level) is its heap count there
+     * or 0 if it is not tracked
+     */
+    template<typename HEAP_COUNT>
+    COUNT_TYPE Recursion(const Code& code, HEAP_COUNT heapCount){
+        COUNT_TYPE ret = LevelQuery(code, code.levels - 1, heapCount(code.levels - 1));
+        for(int32_t i = code.levels - 2;i >= 0;--i){
+            ret = 2 * ret - LevelQuery(code, i, heapCount(i));
+        }
+        return ret;
+    }
+
+    /* The heap count of a tracked flow, else the median of the rows */
+    COUNT_TYPE LevelQuery(const Code& code, uint32_t level, COUNT_TYPE heapCount){
+        if(heapCount != 0)
+            return heapCount;
+
+        COUNT_TYPE result[HASH_NUM];
+        for(uint32_t j = 0;j < HASH_NUM;++j){
+            result[j] = counters[level][j * LENGTH[level] + code.Position(j, LENGTH[level])] * code.Sign(j);
+        }
+        return Median<HASH_NUM>(result);
+    }
 };
 
-#endif
\ No newline at end of file
+template<typename DATA_TYPE>
+constexpr uint32_t UnivMon<DATA_TYPE>::DEFAULT_LEVEL;
+template<typename DATA_TYPE>
+constexpr uint32_t UnivMon<DATA_TYPE>::MAX_LEVEL;
+template<typename DATA_TYPE>
+constexpr uint32_t UnivMon<DATA_TYPE>::HASH_NUM;
+template<typename DATA_TYPE>
+constexpr uint32_t UnivMon<DATA_TYPE>::HASH_SEED;
+template<typename DATA_TYPE>
+constexpr double UnivMon<DATA_TYPE>::HEAVY_RATIO;
+template<typename DATA_TYPE>
+constexpr double UnivMon<DATA_TYPE>::LIGHT_RATIO;
+
+#endif
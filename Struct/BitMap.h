@@ -2,16 +2,21 @@
 #define BITMAP_H
 
 struct BitMap{
-    uint8_t* bitset;
+    uint8_t* bitset = nullptr;
+    uint32_t size;
+    bool mapped = false;
+
+    BitMap(){}
 
     BitMap(uint32_t length){
-        uint32_t size = ((length + 7) >> 3);
+        size = ((length + 7) >> 3);
         bitset = new uint8_t[size];
         memset(bitset, 0, size * sizeof(uint8_t));
     }
 
     ~BitMap(){
-        delete [] bitset;
+        if(!mapped)
+            delete [] bitset;
     }
 
     inline void Set(uint32_t index){
@@ -31,6 +36,16 @@ struct BitMap{
         uint32_t offset = (index & 0x7);
         bitset[position] &= (~(1 << offset));
     }
+
+    inline void Clear(){
+        memset(bitset, 0, size * sizeof(uint8_t));
+    }
+
+    void Serialize(Archive& ar){
+        ar.Attach(mapped);
+        ar.Value(size);
+        ar.Array(bitset, size);
+    }
 };
 
 #endif
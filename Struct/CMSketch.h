@@ -2,31 +2,65 @@
 #define CMSKETCH_H
 
 #include "Util.h"
+#include "Archive.h"
+#include "CounterArray.h"
 
-template<typename DATA_TYPE,typename COUNT_TYPE>
+/*
+ * With CONSERVATIVE, an update only raises the counters of an item up to its
+ * new estimate (conservative update), which overestimates less; weights must
+ * then be non-negative.
+ */
+template<typename DATA_TYPE,typename COUNT_TYPE,typename SLOT_TYPE = COUNT_TYPE,uint32_t HASH_NUM = 4,bool CONSERVATIVE = false>
 class CMSketch{
 public:
 
     CMSketch(uint32_t _MEMORY){
-        LENGTH = _MEMORY / sizeof(COUNT_TYPE) / HASH_NUM;
-
-        sketch = new COUNT_TYPE* [HASH_NUM];
+        sketch = new Row* [HASH_NUM];
         for(uint32_t i = 0;i < HASH_NUM; ++i){
-            sketch[i] = new COUNT_TYPE[LENGTH];
-            memset(sketch[i], 0, sizeof(COUNT_TYPE) * LENGTH);
+            sketch[i] = new Row(_MEMORY / HASH_NUM);
         }
+        LENGTH = sketch[0]->size();
     }
 
+    CMSketch(){}
+
     ~CMSketch(){
-        for(uint32_t i = 0;i < HASH_NUM;++i)
-            delete [] sketch[i];
+        for(uint32_t i = 0;sketch != nullptr && i < HASH_NUM;++i)
+            delete sketch[i];
         delete [] sketch;
     }
 
-    void Insert(const DATA_TYPE item) {
+    void Insert(const DATA_TYPE item, COUNT_TYPE weight = 1) {
+        InsertAndQuery(item, weight);
+    }
+
+    /* Insert, then return what Query would, hashing and touching each row once */
+    COUNT_TYPE InsertAndQuery(const DATA_TYPE item, COUNT_TYPE weight = 1) {
+        uint32_t position[HASH_NUM];
+        COUNT_TYPE ret = 0x7fffffff;
+
         for(uint32_t i = 0; i < HASH_NUM; ++i) {
-            uint32_t position = hash(item, i) % LENGTH;
-            sketch[i][position] += 1;
+            position[i] = hash(item, i, seed) % LENGTH;
+            COUNT_TYPE value = CONSERVATIVE ? sketch[i]->Get(position[i]) : sketch[i]->AddGet(position[i], weight);
+            ret = MIN(ret, value);
+        }
+
+        if(CONSERVATIVE){
+            ret += weight;
+            for(uint32_t i = 0; i < HASH_NUM; ++i) {
+                COUNT_TYPE value = sketch[i]->Get(position[i]);
+                if(value < ret)
+                    sketch[i]->Add(position[i], ret - value);
+            }
+        }
+        return ret;
+    }
+
+    /* Insert that is safe against other InsertShared calls on the same sketch; never conservative */
+    void InsertShared(const DATA_TYPE item, COUNT_TYPE weight = 1) {
+        for(uint32_t i = 0; i < HASH_NUM; ++i) {
+            uint32_t position = hash(item, i, seed) % LENGTH;
+            sketch[i]->AddShared(position, weight);
         }
     }
 
@@ -34,18 +68,53 @@ public:
         COUNT_TYPE ret = 0x7fffffff;
 
         for(uint32_t i = 0; i < HASH_NUM; ++i) {
-            uint32_t position = hash(item, i) % LENGTH;
-            ret = MIN(ret, sketch[i][position]);
+            uint32_t position = hash(item, i, seed) % LENGTH;
+            ret = MIN(ret, sketch[i]->Get(position));
         }
 
         return ret;
     }
 
+    /* Hash seed; set before the first Insert */
+    void Seed(uint32_t _seed){
+        seed = _seed;
+    }
+
+    void Clear(){
+        for(uint32_t i = 0;i < HASH_NUM;++i)
+            sketch[i]->Clear();
+    }
+
+    /* Escalated slots, over all rows, that share a side counter */
+    uint32_t Shared() const{
+        uint32_t ret = 0;
+        for(uint32_t i = 0;i < HASH_NUM;++i)
+            ret += sketch[i]->Shared();
+        return ret;
+    }
+
+    void Serialize(Archive& ar){
+        ar.Param(HASH_NUM);
+        ar.Param(CONSERVATIVE);
+        ar.Value(seed);
+
+        if(ar.Loading()){
+            sketch = new Row* [HASH_NUM]();
+            for(uint32_t i = 0;i < HASH_NUM;++i)
+                sketch[i] = new Row();
+        }
+        for(uint32_t i = 0;i < HASH_NUM;++i)
+            sketch[i]->Serialize(ar);
+        LENGTH = sketch[0]->size();
+    }
+
 private:
+    typedef CounterArray<SLOT_TYPE, COUNT_TYPE> Row;
+
     uint32_t LENGTH;
-    const uint32_t HASH_NUM = 4;
+    uint32_t seed = 0;
 
-    COUNT_TYPE** sketch;
+    Row** sketch = nullptr;
 };
 
 #endif
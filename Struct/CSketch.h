@@ -2,56 +2,119 @@
 #define CSKETCH_H
 
 #include "Util.h"
+#include "Archive.h"
+#include "CounterArray.h"
 
-template<typename DATA_TYPE,typename COUNT_TYPE>
+template<typename DATA_TYPE,typename COUNT_TYPE,typename SLOT_TYPE = COUNT_TYPE,uint32_t HASH_NUM = 3>
 class CSketch{
 public:
 
     CSketch(uint32_t _MEMORY){
-        LENGTH = _MEMORY / sizeof(COUNT_TYPE) / HASH_NUM;
-
-        sketch = new COUNT_TYPE* [HASH_NUM];
+        sketch = new Row* [HASH_NUM];
         for(uint32_t i = 0;i < HASH_NUM; ++i){
-            sketch[i] = new COUNT_TYPE[LENGTH];
-            memset(sketch[i], 0, sizeof(COUNT_TYPE) * LENGTH);
+            sketch[i] = new Row(_MEMORY / HASH_NUM);
         }
+        LENGTH = sketch[0]->size();
     }
 
+    CSketch(){}
+
     ~CSketch(){
-        for(uint32_t i = 0;i < HASH_NUM;++i)
-            delete [] sketch[i];
+        for(uint32_t i = 0;sketch != nullptr && i < HASH_NUM;++i)
+            delete sketch[i];
         delete [] sketch;
     }
 
-    void Insert(const DATA_TYPE item) {
+    void Insert(const DATA_TYPE item, COUNT_TYPE weight = 1) {
+        for(uint32_t i = 0; i < HASH_NUM; ++i) {
+            uint32_t position = hash(item, i, seed) % LENGTH;
+            uint32_t polar = hash(item, i + HASH_NUM, seed) & 1;
+
+            sketch[i]->Add(position, delta[polar] * weight);
+        }
+    }
+
+    /* Insert, then return what Query would, hashing and touching each row once */
+    COUNT_TYPE InsertAndQuery(const DATA_TYPE item, COUNT_TYPE weight = 1) {
+        COUNT_TYPE result[HASH_NUM];
+
+        for(uint32_t i = 0; i < HASH_NUM; ++i) {
+            uint32_t position = hash(item, i, seed) % LENGTH;
+            uint32_t polar = hash(item, i + HASH_NUM, seed) & 1;
+
+            result[i] = sketch[i]->AddGet(position, delta[polar] * weight) * delta[polar];
+        }
+
+        return Median<HASH_NUM>(result);
+    }
+
+    /* Insert that is safe against other InsertShared calls on the same sketch */
+    void InsertShared(const DATA_TYPE item, COUNT_TYPE weight = 1) {
         for(uint32_t i = 0; i < HASH_NUM; ++i) {
-            uint32_t position = hash(item, i) % LENGTH;
-            uint32_t polar = hash(item, i + HASH_NUM) & 1;
+            uint32_t position = hash(item, i, seed) % LENGTH;
+            uint32_t polar = hash(item, i + HASH_NUM, seed) & 1;
 
-            sketch[i][position] += delta[polar];
+            sketch[i]->AddShared(position, delta[polar] * weight);
         }
     }
 
     COUNT_TYPE Query(const DATA_TYPE item){
-        std::vector<COUNT_TYPE> result(HASH_NUM);
+        COUNT_TYPE result[HASH_NUM];
 
         for(uint32_t i = 0; i < HASH_NUM; ++i) {
-            uint32_t position = hash(item, i) % LENGTH;
-            uint32_t polar = hash(item, i + HASH_NUM) & 1;
+            uint32_t position = hash(item, i, seed) % LENGTH;
+            uint32_t polar = hash(item, i + HASH_NUM, seed) & 1;
 
-            result[i] = sketch[i][position] * delta[polar];
+            result[i] = sketch[i]->Get(position) * delta[polar];
         }
 
-        return Median(result, HASH_NUM);
+        return Median<HASH_NUM>(result);
+    }
+
+    /* Hash seed; set before the first Insert */
+    void Seed(uint32_t _seed){
+        seed = _seed;
+    }
+
+    void Clear(){
+        for(uint32_t i = 0;i < HASH_NUM;++i)
+            sketch[i]->Clear();
+    }
+
+    /* Escalated slots, over all rows, that share a side counter */
+    uint32_t Shared() const{
+        uint32_t ret = 0;
+        for(uint32_t i = 0;i < HASH_NUM;++i)
+            ret += sketch[i]->Shared();
+        return ret;
+    }
+
+    void Serialize(Archive& ar){
+        ar.Param(HASH_NUM);
+        ar.Value(seed);
+
+        if(ar.Loading()){
+            sketch = new Row* [HASH_NUM]();
+            for(uint32_t i = 0;i < HASH_NUM;++i)
+                sketch[i] = new Row();
+        }
+        for(uint32_t i = 0;i < HASH_NUM;++i)
+            sketch[i]->Serialize(ar);
+        LENGTH = sketch[0]->size();
     }
 
 private:
-    const int32_t delta[2] = {+1, -1};
+    typedef CounterArray<SLOT_TYPE, COUNT_TYPE> Row;
+
+    static constexpr int32_t delta[2] = {+1, -1};
 
     uint32_t LENGTH;
-    const uint32_t HASH_NUM = 3;
+    uint32_t seed = 0;
 
-    COUNT_TYPE** sketch;
+    Row** sketch = nullptr;
 };
 
+template<typename DATA_TYPE,typename COUNT_TYPE,typename SLOT_TYPE,uint32_t HASH_NUM>
+constexpr int32_t CSketch<DATA_TYPE, COUNT_TYPE, SLOT_TYPE, HASH_NUM>::delta[2];
+
 #endif
@@ -2,6 +2,7 @@
 #define COLDFILTER_H
 
 #include "Util.h"
+#include "Archive.h"
 #include <vector>
 #include <cstdint>
 #include <algorithm>
@@ -47,6 +48,7 @@ public:
         // }
     }
 
+    ColdFilter() = default;
     ~ColdFilter() = default;
 
     COUNT_TYPE Insert(const DATA_TYPE item) {
@@ -81,6 +83,20 @@ public:
         return ret;
     }
 
+    void Clear() {
+        std::fill(layer1.begin(), layer1.end(), 0);
+        std::fill(layer2.begin(), layer2.end(), 0);
+    }
+
+    void Serialize(Archive& ar) {
+        ar.Param(HASH_NUM);
+        ar.Param(L1_COUNTER_BIT);
+        ar.Param(L2_COUNTER_BIT);
+        ar.Vector(layer1);
+        ar.Vector(layer2);
+        ar.Vector(thresholds);
+    }
+
 private:
     std::vector<uint8_t> layer1;
     std::vector<uint16_t> layer2;
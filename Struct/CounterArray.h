@@ -0,0 +1,220 @@
+#ifndef COUNTERARRAY_H
+#define COUNTERARRAY_H
+
+#include "Util.h"
+#include "Archive.h"
+#include <limits>
+
+/*
+ * Array of SLOT_TYPE-wide counters read and written as COUNT_TYPE. When a narrow
+ * slot would overflow it is set to ESCALATED and its value moves to a wide
+ * counter in a small side table, like the second layer of ColdFilter. A side
+ * entry is tagged with the slot it belongs to and found by linear probing from
+ * the slot's position, so escalated slots keep their own counters. Only when
+ * all PROBES entries from there are taken does a slot share the first one;
+ * Shared() counts such slots, whose reads are the sum of the sharers (and
+ * opposite signs cancel in a signed array).
+ * With SLOT_TYPE as wide as COUNT_TYPE this is a plain array.
+ * AddShared may run on several threads at once; Add, Get and Clear may not run
+ * concurrently with it.
+ */
+template<typename SLOT_TYPE, typename COUNT_TYPE>
+class CounterArray{
+public:
+    static constexpr bool NARROW = sizeof(SLOT_TYPE) < sizeof(COUNT_TYPE);
+
+    static constexpr SLOT_TYPE ESCALATED = std::numeric_limits<SLOT_TYPE>::is_signed ?
+        std::numeric_limits<SLOT_TYPE>::min() : std::numeric_limits<SLOT_TYPE>::max();
+    static constexpr COUNT_TYPE SLOT_MAX = std::numeric_limits<SLOT_TYPE>::is_signed ?
+        std::numeric_limits<SLOT_TYPE>::max() : std::numeric_limits<SLOT_TYPE>::max() - 1;
+    static constexpr COUNT_TYPE SLOT_MIN = std::numeric_limits<SLOT_TYPE>::is_signed ?
+        std::numeric_limits<SLOT_TYPE>::min() + 1 : 0;
+
+    static constexpr uint32_t PROBES = 8;
+
+    /* Wide counter of one escalated slot; tag is the slot's position + 1, 0 while free */
+    struct Side{
+        uint32_t tag;
+        COUNT_TYPE count;
+
+        void Code(Archive& ar){
+            ar.Count(tag);
+            ar.Count(count);
+        }
+    };
+
+    CounterArray(){}
+
+    CounterArray(uint32_t _MEMORY){
+        SIDE_LENGTH = NARROW ? std::max<uint32_t>(_MEMORY * SIDE_RATIO / sizeof(Side), 1) : 0;
+        LENGTH = (_MEMORY - SIDE_LENGTH * sizeof(Side)) / sizeof(SLOT_TYPE);
+
+        slots = new SLOT_TYPE[LENGTH];
+        side = new Side[SIDE_LENGTH];
+        Clear();
+    }
+
+    ~CounterArray(){
+        if(!mapped){
+            delete [] slots;
+            delete [] side;
+        }
+    }
+
+    inline uint32_t size() const{
+        return LENGTH;
+    }
+
+    inline COUNT_TYPE Get(uint32_t pos) const{
+        if(!NARROW)
+            return slots[pos];
+
+        SLOT_TYPE value = slots[pos];
+        return (value == ESCALATED) ? side[Find(pos)].count : value;
+    }
+
+    inline void Add(uint32_t pos, COUNT_TYPE delta){
+        if(!NARROW){
+            slots[pos] += delta;
+            return;
+        }
+
+        SLOT_TYPE value = slots[pos];
+        if(value == ESCALATED){
+            side[Find(pos)].count += delta;
+            return;
+        }
+
+        COUNT_TYPE sum = value + delta;
+        if(sum > SLOT_MAX || sum < SLOT_MIN){
+            slots[pos] = ESCALATED;
+            uint32_t entry = Claim(pos);
+            shared += (side[entry].tag != pos + 1);
+            side[entry].count += sum;
+        }
+        else{
+            slots[pos] = sum;
+        }
+    }
+
+    /* Add, returning the value Get reads afterwards */
+    inline COUNT_TYPE AddGet(uint32_t pos, COUNT_TYPE delta){
+        if(!NARROW)
+            return slots[pos] += delta;
+
+        Add(pos, delta);
+        return Get(pos);
+    }
+
+    /*
+     * Add for many writers at once: relaxed atomics, with a CAS loop on narrow
+     * slots. Writers of an escalated slot may get there before the one that
+     * escalated it, so every one of them claims the entry; they probe in the
+     * same order and settle on the same one.
+     */
+    inline void AddShared(uint32_t pos, COUNT_TYPE delta){
+        if(!NARROW){
+            __atomic_fetch_add(&slots[pos], delta, __ATOMIC_RELAXED);
+            return;
+        }
+
+        SLOT_TYPE value = __atomic_load_n(&slots[pos], __ATOMIC_RELAXED);
+        while(value != ESCALATED){
+            COUNT_TYPE sum = value + delta;
+            bool escalate = (sum > SLOT_MAX || sum < SLOT_MIN);
+            SLOT_TYPE next = escalate ? ESCALATED : (SLOT_TYPE)sum;
+            if(__atomic_compare_exchange_n(&slots[pos], &value, next, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)){
+                if(escalate){
+                    uint32_t entry = ClaimShared(pos);
+                    if(__atomic_load_n(&side[entry].tag, __ATOMIC_RELAXED) != pos + 1)
+                        __atomic_fetch_add(&shared, 1, __ATOMIC_RELAXED);
+                    __atomic_fetch_add(&side[entry].count, sum, __ATOMIC_RELAXED);
+                }
+                return;
+            }
+        }
+        __atomic_fetch_add(&side[ClaimShared(pos)].count, delta, __ATOMIC_RELAXED);
+    }
+
+    /* Escalated slots that found no free side entry and share another slot's */
+    inline uint32_t Shared() const{
+        return shared;
+    }
+
+    void Clear(){
+        memset(slots, 0, sizeof(SLOT_TYPE) * LENGTH);
+        memset(side, 0, sizeof(Side) * SIDE_LENGTH);
+        shared = 0;
+    }
+
+    void Serialize(Archive& ar){
+        ar.Attach(mapped);
+        ar.Param((uint32_t)sizeof(SLOT_TYPE));
+        ar.Value(LENGTH);
+        ar.Value(SIDE_LENGTH);
+        ar.Value(shared);
+        ar.Array(slots, LENGTH);
+        ar.Array(side, SIDE_LENGTH);
+    }
+
+private:
+    /* 8-bit slots escalate at a few hundred, so far more of them need a side counter */
+    const double SIDE_RATIO = (sizeof(SLOT_TYPE) == 1) ? 0.25 : 0.0625;
+
+    uint32_t LENGTH;
+    uint32_t SIDE_LENGTH;
+    uint32_t shared = 0;
+
+    SLOT_TYPE* slots = nullptr;
+    Side* side = nullptr;
+    bool mapped = false;
+
+    /* Entry of an escalated slot: its own, or the first probed one if it shares */
+    inline uint32_t Find(uint32_t pos) const{
+        uint32_t home = pos % SIDE_LENGTH;
+        for(uint32_t i = 0, entry = home;i < PROBES && i < SIDE_LENGTH;++i){
+            if(side[entry].tag == pos + 1)
+                return entry;
+            if(side[entry].tag == 0)
+                break;
+            entry = (entry + 1 == SIDE_LENGTH) ? 0 : entry + 1;
+        }
+        return home;
+    }
+
+    /* Find, taking the first free entry when the slot has none yet */
+    inline uint32_t Claim(uint32_t pos){
+        uint32_t home = pos % SIDE_LENGTH;
+        for(uint32_t i = 0, entry = home;i < PROBES && i < SIDE_LENGTH;++i){
+            if(side[entry].tag == 0)
+                side[entry].tag = pos + 1;
+            if(side[entry].tag == pos + 1)
+                return entry;
+            entry = (entry + 1 == SIDE_LENGTH) ? 0 : entry + 1;
+        }
+        return home;
+    }
+
+    inline uint32_t ClaimShared(uint32_t pos){
+        uint32_t home = pos % SIDE_LENGTH;
+        for(uint32_t i = 0, entry = home;i < PROBES && i < SIDE_LENGTH;++i){
+            uint32_t tag = 0;
+            if(__atomic_compare_exchange_n(&side[entry].tag, &tag, pos + 1, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)
+               || tag == pos + 1)
+                return entry;
+            entry = (entry + 1 == SIDE_LENGTH) ? 0 : entry + 1;
+        }
+        return home;
+    }
+};
+
+template<typename SLOT_TYPE, typename COUNT_TYPE>
+constexpr uint32_t CounterArray<SLOT_TYPE, COUNT_TYPE>::PROBES;
+template<typename SLOT_TYPE, typename COUNT_TYPE>
+constexpr SLOT_TYPE CounterArray<SLOT_TYPE, COUNT_TYPE>::ESCALATED;
+template<typename SLOT_TYPE, typename COUNT_TYPE>
+constexpr COUNT_TYPE CounterArray<SLOT_TYPE, COUNT_TYPE>::SLOT_MAX;
+template<typename SLOT_TYPE, typename COUNT_TYPE>
+constexpr COUNT_TYPE CounterArray<SLOT_TYPE, COUNT_TYPE>::SLOT_MIN;
+
+#endif
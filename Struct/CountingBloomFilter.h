@@ -2,9 +2,11 @@
 #define COUNTINGBLOOMFILTER_H
 
 #include "Util.h"
+#include "Archive.h"
 #include <vector>
 #include <cstdint>
 #include <algorithm>
+#include <limits>
 
 template<typename DATA_TYPE, typename COUNT_TYPE>
 class CountingBloomFilter {
@@ -16,21 +18,66 @@ public:
         filter.resize(LENGTH, 0);
     }
 
+    CountingBloomFilter() = default;
     ~CountingBloomFilter() = default;
 
-    COUNT_TYPE Insert(const DATA_TYPE item) {
-        return std::min(++filter[hash(item, 0) % LENGTH], ++filter[hash(item, 1) % LENGTH]);
+    COUNT_TYPE Insert(const DATA_TYPE item, COUNT_TYPE weight = 1) {
+        return std::min(Increment(hash(item, 0, seed) % LENGTH, weight), Increment(hash(item, 1, seed) % LENGTH, weight));
+    }
+
+    /* Insert that is safe against other InsertShared calls on the same filter */
+    COUNT_TYPE InsertShared(const DATA_TYPE item, COUNT_TYPE weight = 1) {
+        return std::min(IncrementShared(hash(item, 0, seed) % LENGTH, weight), IncrementShared(hash(item, 1, seed) % LENGTH, weight));
     }
 
     COUNT_TYPE Query(const DATA_TYPE item) {
-        return std::min(filter[hash(item, 0) % LENGTH], filter[hash(item, 1) % LENGTH]);
+        return std::min(filter[hash(item, 0, seed) % LENGTH], filter[hash(item, 1, seed) % LENGTH]);
+    }
+
+    /* Hash seed; set before the first Insert */
+    void Seed(uint32_t _seed) {
+        seed = _seed;
+    }
+
+    void Clear() {
+        std::fill(filter.begin(), filter.end(), 0);
+    }
+
+    void Serialize(Archive& ar) {
+        ar.Param(HASH_NUM);
+        ar.Value(seed);
+        ar.Value(COUNTER_BIT);
+        ar.Value(LENGTH);
+        ar.Vector(filter);
     }
 
 private:
-    std::vector<uint16_t> filter;
-    uint32_t COUNTER_BIT = 16;
+    /* Wide enough for byte counts: a flow of a weighted trace passes 65535 early */
+    std::vector<uint32_t> filter;
+    uint32_t COUNTER_BIT = 32;
     const uint32_t HASH_NUM = 2;
     uint32_t LENGTH;
+    uint32_t seed = 0;
+
+    /* Counters saturate at the largest COUNT_TYPE instead of wrapping */
+    static constexpr uint64_t LIMIT = std::numeric_limits<COUNT_TYPE>::max();
+
+    inline COUNT_TYPE Increment(uint32_t pos, COUNT_TYPE weight) {
+        filter[pos] = std::min<uint64_t>((uint64_t)filter[pos] + weight, LIMIT);
+        return filter[pos];
+    }
+
+    inline COUNT_TYPE IncrementShared(uint32_t pos, COUNT_TYPE weight) {
+        uint32_t value = __atomic_load_n(&filter[pos], __ATOMIC_RELAXED);
+        uint32_t next;
+        do {
+            next = std::min<uint64_t>((uint64_t)value + weight, LIMIT);
+        } while(value != next && !__atomic_compare_exchange_n(&filter[pos], &value, next, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+        return next;
+    }
 };
 
+template<typename DATA_TYPE, typename COUNT_TYPE>
+constexpr uint64_t CountingBloomFilter<DATA_TYPE, COUNT_TYPE>::LIMIT;
+
 #endif
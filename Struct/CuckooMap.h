@@ -2,6 +2,7 @@
 #define CUCKOOMAP_H
 
 #include "Util.h"
+#include "Archive.h"
 #include "BitMap.h"
 
 #define LOAD 0.5
@@ -19,6 +20,13 @@ public:
     struct Bucket{
         KEY_TYPE keys[SLOT_PER_BUCKET];
         VALUE_TYPE values[SLOT_PER_BUCKET];
+
+        void Code(Archive& ar){
+            for(uint32_t slot = 0;slot < SLOT_PER_BUCKET;++slot){
+                ar.Key(keys[slot]);
+                ar.Count(values[slot]);
+            }
+        }
     };
 
     CuckooMap(uint32_t SIZE){
@@ -32,10 +40,13 @@ public:
         }
     }
 
+    CuckooMap(){}
+
     ~CuckooMap(){
         for(uint32_t i = 0;i < ARRAY_NUM;++i){
             delete bitmaps[i];
-            delete [] buckets[i];
+            if(!mapped)
+                delete [] buckets[i];
         }
     }
 
@@ -70,7 +81,7 @@ public:
 
         uint32_t choice = 0;
         for(uint32_t kick_num = 0;kick_num < MAX_KICK;++kick_num){
-            uint32_t slot = rd() % SLOT_PER_BUCKET;
+            uint32_t slot = random() % SLOT_PER_BUCKET;
 
             KEY_TYPE tempKey = buckets[choice][pos[choice]].keys[slot];
             VALUE_TYPE tempValue = buckets[choice][pos[choice]].values[slot];
@@ -162,12 +173,39 @@ public:
         throw;
     }
 
+    void Clear(){
+        inserted = 0;
+        for(uint32_t i = 0;i < ARRAY_NUM;++i){
+            bitmaps[i]->Clear();
+            memset(buckets[i], 0, length * sizeof(Bucket));
+        }
+    }
+
+    void Serialize(Archive& ar){
+        ar.Attach(mapped);
+        ar.Param((uint32_t)ARRAY_NUM);
+        ar.Param((uint32_t)SLOT_PER_BUCKET);
+        ar.Value(length);
+        ar.Value(inserted);
+
+        for(uint32_t i = 0;i < ARRAY_NUM;++i){
+            if(ar.Loading())
+                bitmaps[i] = new BitMap();
+            bitmaps[i]->Serialize(ar);
+            ar.Array(buckets[i], length);
+        }
+    }
+
 protected:
     uint32_t length;
     uint32_t inserted;
+    bool mapped = false;
+
+    /* Kick-out choices only move entries around; a fixed stream keeps runs repeatable */
+    Random random;
 
-    BitMap* bitmaps[ARRAY_NUM];
-    Bucket* buckets[ARRAY_NUM];
+    BitMap* bitmaps[ARRAY_NUM] = {};
+    Bucket* buckets[ARRAY_NUM] = {};
 };
 
 
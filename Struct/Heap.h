@@ -16,13 +16,15 @@ public:
     Heap(uint32_t _SIZE){
 	    SIZE = _SIZE;
         mp = new Cuckoo(SIZE);
-        heap = new KV[SIZE];
-        memset(heap, 0, sizeof(KV) * SIZE);
+        heap = new KV[SIZE]();
     }
 
+    Heap(){}
+
     ~Heap(){
         delete mp;
-        delete [] heap;
+        if(!mapped)
+            delete [] heap;
     }
 
     static uint32_t Size2Memory(uint32_t size){
@@ -35,9 +37,10 @@ public:
                          + sizeof(DATA_TYPE) + sizeof(COUNT_TYPE));
     }
 
-    void Insert(const DATA_TYPE item, const COUNT_TYPE frequency){
+    /* frequency decides admission; a tracked item counts the weight of its own updates */
+    void Insert(const DATA_TYPE item, const COUNT_TYPE frequency, const COUNT_TYPE weight = 1){
         if(mp->Lookup(item))
-            this->Add_Data(item);
+            this->Add_Data(item, weight);
         else{
             if(this->isFull()){
                 if(frequency > heap[0].first){
@@ -49,7 +52,7 @@ public:
                 }
             }
             else
-                this->New_Data(item);
+                this->New_Data(item, weight);
         }
     }
 
@@ -66,24 +69,40 @@ public:
         return ret;
     }
 
+    void Clear(){
+        mp->Clear();
+        std::fill(heap, heap + SIZE, KV());
+    }
+
+    void Serialize(Archive& ar){
+        ar.Attach(mapped);
+        ar.Value(SIZE);
+
+        if(ar.Loading())
+            mp = new Cuckoo();
+        mp->Serialize(ar);
+        ar.Array(heap, SIZE);
+    }
+
 protected:
     uint32_t SIZE;
-    Cuckoo* mp;
-    KV* heap;
+    Cuckoo* mp = nullptr;
+    KV* heap = nullptr;
+    bool mapped = false;
 
     inline bool isFull(){
         return mp->size() >= SIZE;
     }
 
-    void Add_Data(const DATA_TYPE& data){
+    void Add_Data(const DATA_TYPE& data, COUNT_TYPE weight = 1){
         uint32_t pos = (*mp)[data];
-        heap[pos].first += 1;
+        heap[pos].first += weight;
         Heap_Down(pos);
     }
 
-    void New_Data(const DATA_TYPE& data){
+    void New_Data(const DATA_TYPE& data, COUNT_TYPE weight = 1){
         uint32_t pos = mp->size();
-        heap[pos].first = 1;
+        heap[pos].first = weight;
         heap[pos].second = data;
         mp->Insert(data, pos);
         Heap_Up(pos);
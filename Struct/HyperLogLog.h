@@ -0,0 +1,98 @@
+#ifndef HYPERLOGLOG_H
+#define HYPERLOGLOG_H
+
+#include "Util.h"
+#include "Archive.h"
+
+/*
+ * Distinct count over 2^PRECISION one-byte registers, fed with 64-bit hashes
+ * that the caller may already have computed for its own tables. The top bits
+ * pick the register, which keeps the longest run of leading zeros of the rest.
+ * While many registers are still empty the estimate is linear counting.
+ * Merge takes the register-wise maximum with the widest vectors the CPU has
+ * (MaxBytes in Dispatch.h).
+ */
+class HyperLogLog{
+public:
+    HyperLogLog(uint32_t _MEMORY){
+        PRECISION = std::min<uint32_t>(std::max<uint32_t>(std::log2(std::max<uint32_t>(_MEMORY, 1)), MIN_PRECISION), MAX_PRECISION);
+        REGISTERS = 1u << PRECISION;
+        registers = new uint8_t[REGISTERS];
+        Clear();
+    }
+
+    HyperLogLog(){}
+
+    ~HyperLogLog(){
+        if(!mapped)
+            delete [] registers;
+    }
+
+    inline uint32_t Memory() const{
+        return REGISTERS;
+    }
+
+    inline void Insert(uint64_t code){
+        Insert(registers, PRECISION, code);
+    }
+
+    double Estimate() const{
+        return Estimate(registers, REGISTERS);
+    }
+
+    /* The register update and estimate on 2^precision registers held elsewhere */
+    static inline void Insert(uint8_t* registers, uint32_t precision, uint64_t code){
+        uint32_t index = code >> (64 - precision);
+        uint8_t rank = __builtin_clzll((code << precision) | (1ULL << (precision - 1))) + 1;
+        if(rank > registers[index])
+            registers[index] = rank;
+    }
+
+    static double Estimate(const uint8_t* registers, uint32_t count){
+        double sum = 0;
+        uint32_t zeros = 0;
+        for(uint32_t i = 0;i < count;++i){
+            sum += std::ldexp(1.0, -registers[i]);
+            zeros += (registers[i] == 0);
+        }
+
+        double m = count;
+        double raw = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+        if(raw <= 2.5 * m && zeros != 0)
+            return m * std::log(m / zeros);
+        return raw;
+    }
+
+    /* Union with an estimator of the same precision */
+    void Merge(const HyperLogLog& other){
+        if(other.PRECISION != PRECISION)
+            throw std::invalid_argument("HyperLogLog merge needs the same precision");
+
+        CpuKernels().MaxBytes(registers, other.registers, REGISTERS);
+    }
+
+    void Clear(){
+        memset(registers, 0, REGISTERS);
+    }
+
+    void Serialize(Archive& ar){
+        ar.Attach(mapped);
+        ar.Value(PRECISION);
+        REGISTERS = 1u << PRECISION;
+        ar.Array(registers, REGISTERS);
+    }
+
+private:
+    static constexpr uint32_t MIN_PRECISION = 4;
+    static constexpr uint32_t MAX_PRECISION = 18;
+
+    uint32_t PRECISION;
+    uint32_t REGISTERS;
+    uint8_t* registers = nullptr;
+    bool mapped = false;
+};
+
+constexpr uint32_t HyperLogLog::MIN_PRECISION;
+constexpr uint32_t HyperLogLog::MAX_PRECISION;
+
+#endif
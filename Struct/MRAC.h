@@ -0,0 +1,160 @@
+#ifndef MRAC_H
+#define MRAC_H
+
+#include "Util.h"
+
+/*
+ * Flow-size distribution from a histogram of counter values, by the EM of
+ * MRAC: a counter holding v is explained by every split of v into at most
+ * three flows (two once v exceeds TRIPLE_LIMIT), weighted by how likely the
+ * current estimate makes that collision. Each round splits the counter values
+ * over THREADS threads, and the rounds stop once the estimate moves less than
+ * TOLERANCE of the flow count, after MAX_ROUNDS, or before a round of average
+ * length would overrun BUDGET (in the unit of durationms).
+ */
+class MRAC{
+public:
+    MRAC(uint32_t _THREADS = 1, uint32_t _MAX_ROUNDS = 20, double _TOLERANCE = 1e-3, double _BUDGET = 0){
+        THREADS = std::max<uint32_t>(_THREADS, 1);
+        MAX_ROUNDS = _MAX_ROUNDS;
+        TOLERANCE = _TOLERANCE;
+        BUDGET = _BUDGET;
+        rounds = 0;
+    }
+
+    /*
+     * Estimated number of flows of each size, indexed by size, from the number
+     * of counters holding each value; histogram[0] counts the empty counters
+     */
+    std::vector<double> Estimate(const std::vector<uint64_t>& histogram){
+        double COUNTERS = 0;
+        std::vector<uint32_t> values;
+        std::vector<double> dist(histogram.size(), 0);
+        for(uint32_t v = 0;v < histogram.size();++v){
+            COUNTERS += histogram[v];
+            if(v > 0 && histogram[v] > 0){
+                values.push_back(v);
+                dist[v] = histogram[v];
+            }
+        }
+
+        TP start = now();
+        std::vector<double> share(dist.size());
+        std::vector<std::vector<double>> next(THREADS, std::vector<double>(dist.size()));
+        for(rounds = 0;rounds < MAX_ROUNDS;){
+            for(uint32_t v = 0;v < dist.size();++v)
+                share[v] = dist[v] / COUNTERS;
+
+            auto job = [&](uint32_t t){
+                std::fill(next[t].begin(), next[t].end(), 0);
+                for(uint64_t i = t;i < values.size();i += THREADS)
+                    Split(values[i], histogram[values[i]], share, next[t]);
+            };
+            std::vector<std::thread> workers;
+            for(uint32_t t = 1;t < THREADS;++t)
+                workers.emplace_back(job, t);
+            job(0);
+            for(auto& worker : workers)
+                worker.join();
+
+            double change = 0, flows = 0;
+            for(uint32_t v = 0;v < dist.size();++v){
+                for(uint32_t t = 1;t < THREADS;++t)
+                    next[0][v] += next[t][v];
+                change += std::abs(next[0][v] - dist[v]);
+                flows += next[0][v];
+            }
+            dist.swap(next[0]);
+            rounds += 1;
+
+            if(change <= TOLERANCE * flows)
+                break;
+            double elapsed = durationms(now(), start);
+            if(BUDGET > 0 && elapsed + elapsed / rounds > BUDGET)
+                break;
+        }
+        return dist;
+    }
+
+    /* Rounds the last Estimate ran */
+    inline uint32_t Rounds() const{
+        return rounds;
+    }
+
+    /* Entropy in bits of the packets over flows, from flow counts indexed by size */
+    static double Entropy(const std::vector<double>& dist){
+        double packets = 0, sum = 0;
+        for(uint32_t s = 1;s < dist.size();++s){
+            packets += s * dist[s];
+            sum += dist[s] * s * std::log2((double)s);
+        }
+        if(packets == 0)
+            return 0;
+        return std::log2(packets) - sum / packets;
+    }
+
+private:
+    static constexpr uint32_t TRIPLE_LIMIT = 256;
+
+    uint32_t THREADS;
+    uint32_t MAX_ROUNDS;
+    double TOLERANCE;
+    double BUDGET;
+    uint32_t rounds;
+
+    /*
+     * Hands the COUNT counters holding VALUE to the flow sizes of its splits,
+     * in proportion to the Poisson weight of each split, prod (share^c / c!)
+     * over the distinct sizes of c flows each
+     */
+    void Split(uint32_t VALUE, uint64_t COUNT, const std::vector<double>& share, std::vector<double>& out){
+        double total = share[VALUE];
+        for(uint32_t a = 1;2 * a <= VALUE;++a)
+            total += Pair(a, VALUE - a, share);
+        if(VALUE <= TRIPLE_LIMIT){
+            for(uint32_t a = 1;3 * a <= VALUE;++a)
+                for(uint32_t b = a;2 * b <= VALUE - a;++b)
+                    total += Triple(a, b, VALUE - a - b, share);
+        }
+        if(total <= 0)
+            return;
+
+        double scale = COUNT / total;
+        out[VALUE] += share[VALUE] * scale;
+        for(uint32_t a = 1;2 * a <= VALUE;++a){
+            double weight = Pair(a, VALUE - a, share) * scale;
+            out[a] += weight;
+            out[VALUE - a] += weight;
+        }
+        if(VALUE <= TRIPLE_LIMIT){
+            for(uint32_t a = 1;3 * a <= VALUE;++a){
+                for(uint32_t b = a;2 * b <= VALUE - a;++b){
+                    double weight = Triple(a, b, VALUE - a - b, share) * scale;
+                    out[a] += weight;
+                    out[b] += weight;
+                    out[VALUE - a - b] += weight;
+                }
+            }
+        }
+    }
+
+    /* Weight of two flows a <= b */
+    static inline double Pair(uint32_t a, uint32_t b, const std::vector<double>& share){
+        double weight = share[a] * share[b];
+        return (a == b) ? weight / 2 : weight;
+    }
+
+    /* Weight of three flows a <= b <= c */
+    static inline double Triple(uint32_t a, uint32_t b, uint32_t c, const std::vector<double>& share){
+        double weight = share[a] * share[b] * share[c];
+        if(a == c)
+            return weight / 6;
+        if(a == b || b == c)
+            return weight / 2;
+        return weight;
+    }
+};
+
+constexpr uint32_t MRAC::TRIPLE_LIMIT;
+
+#endif
@@ -24,6 +24,50 @@ public:
     }
 };
 
+/*
+ * Fixed number of nodes, constructed in place and handed back through a free
+ * list, so the summary does not touch the allocator once it is built.
+ */
+template<typename NODE>
+class NodePool{
+public:
+    NodePool(uint32_t _SIZE){
+        SIZE = _SIZE;
+        nodes = static_cast<NODE*>(::operator new(sizeof(NODE) * SIZE));
+        free = new NODE* [SIZE];
+        Reset();
+    }
+
+    ~NodePool(){
+        ::operator delete(nodes);
+        delete [] free;
+    }
+
+    template<typename... ARGS>
+    inline NODE* New(ARGS... args){
+        if(top == 0)
+            throw std::runtime_error("StreamSummary node pool is exhausted");
+        return new (free[--top]) NODE(args...);
+    }
+
+    inline void Delete(NODE* node){
+        free[top++] = node;
+    }
+
+    /* Take every node back at once */
+    void Reset(){
+        for(uint32_t i = 0;i < SIZE;++i)
+            free[i] = nodes + SIZE - 1 - i;
+        top = SIZE;
+    }
+
+private:
+    uint32_t SIZE;
+    uint32_t top;
+    NODE* nodes;
+    NODE** free;
+};
+
 template<typename DATA_TYPE, typename COUNT_TYPE>
 class StreamSummary{
 public:
@@ -49,25 +93,15 @@ public:
     StreamSummary(uint32_t _SIZE){
 	    SIZE = _SIZE;
         mp = new Cuckoo(SIZE);
-        min = new CountNode();
+        Allocate();
     }
 
+    StreamSummary(){}
+
     ~StreamSummary(){
         delete mp;
-        CountNode* pCount = min;
-        while(pCount){
-
-            DataNode* pData = pCount->pData;
-            while(pData){
-                DataNode* nextData = (DataNode*)pData->next;
-                delete pData;
-                pData = nextData;
-            }
-
-            CountNode* nextCount = (CountNode*)pCount->next;
-            delete pCount;
-            pCount = nextCount;
-        }
+        delete dataPool;
+        delete countPool;
     }
 
     static uint32_t Size2Memory(uint32_t size){
@@ -81,10 +115,17 @@ public:
     }
 
     uint32_t SIZE;
-    Cuckoo* mp;
+    Cuckoo* mp = nullptr;
     CountNode* min;
 
 
+    void Clear(){
+        mp->Clear();
+        dataPool->Reset();
+        countPool->Reset();
+        min = countPool->New();
+    }
+
     inline COUNT_TYPE getMin() {
         return min->next->ID;
     }
@@ -111,9 +152,9 @@ public:
         return ret;
     }
 
-    inline void New_Data(const DATA_TYPE& data){
-        DataNode* pData = new DataNode(data);
-        Add_Count(min, pData);
+    inline void New_Data(const DATA_TYPE& data, COUNT_TYPE weight = 1){
+        DataNode* pData = dataPool->New(data);
+        Add_Count(min, pData, weight);
         mp->Insert(data, pData);
     }
 
@@ -121,7 +162,7 @@ public:
         Add_Data(((CountNode*)min->next)->pData->ID);
     }
 
-    void Add_Data(const DATA_TYPE& data){
+    void Add_Data(const DATA_TYPE& data, COUNT_TYPE weight = 1){
         DataNode* pData = (*mp)[data];
         CountNode* pCount = pData->pCount;
 
@@ -132,19 +173,24 @@ public:
             del = !pData->next;
         }
 
-        Add_Count(pCount, pData);
+        Add_Count(pCount, pData, weight);
 
         if(del){
             pCount->Delete();
-            delete pCount;
+            countPool->Delete(pCount);
         }
     }
 
-    void Add_Count(CountNode* pCount, DataNode* pData){
+    /* Move pData to the group of pCount->ID + weight, creating it if needed */
+    void Add_Count(CountNode* pCount, DataNode* pData, COUNT_TYPE weight = 1){
+        COUNT_TYPE target = pCount->ID + weight;
+        while(pCount->next && pCount->next->ID < target)
+            pCount = (CountNode*)pCount->next;
+
         if(!pCount->next)
-            pCount->Connect(pCount, new CountNode(pCount->ID + 1));
-        else if(pCount->next->ID - pCount->ID > 1){
-            CountNode* add = new CountNode(pCount->ID + 1);
+            pCount->Connect(pCount, countPool->New(target));
+        else if(pCount->next->ID != target){
+            CountNode* add = countPool->New(target);
             pCount->Connect(add, pCount->next);
             pCount->Connect(pCount, add);
         }
@@ -155,21 +201,89 @@ public:
         pData->pCount->pData = pData;
     }
 
-    void SS_Replace(const DATA_TYPE& data){
+    void SS_Replace(const DATA_TYPE& data, COUNT_TYPE weight = 1){
         CountNode* pCount = (CountNode*)min->next;
-        DataNode* pData = new DataNode(data);
+        DataNode* pData = dataPool->New(data);
 
         mp->Insert(data, pData);
-        Add_Count(pCount, pData);
+        Add_Count(pCount, pData, weight);
         pData = pCount->pData;
         pCount->pData = (DataNode*)pData->next;
         pData->Delete();
         if(!pData->next){
             pCount->Delete();
-            delete pCount;
+            countPool->Delete(pCount);
         }
         mp->Delete(pData->ID);
-        delete pData;
+        dataPool->Delete(pData);
+    }
+
+    /* The linked lists are stored as (count, IDs) groups and rebuilt on load */
+    void Serialize(Archive& ar){
+        ar.Value(SIZE);
+
+        if(!ar.Loading()){
+            uint32_t groups = 0;
+            for(CountNode* pCount = (CountNode*)min->next;pCount;pCount = (CountNode*)pCount->next)
+                groups += 1;
+            ar.Value(groups);
+
+            for(CountNode* pCount = (CountNode*)min->next;pCount;pCount = (CountNode*)pCount->next){
+                uint32_t number = 0;
+                for(DataNode* pData = pCount->pData;pData;pData = (DataNode*)pData->next)
+                    number += 1;
+                ar.Value(pCount->ID);
+                ar.Value(number);
+                for(DataNode* pData = pCount->pData;pData;pData = (DataNode*)pData->next)
+                    ar.Value(pData->ID);
+            }
+        }
+        else{
+            mp = new Cuckoo(SIZE);
+            Allocate();
+
+            uint32_t groups;
+            ar.Value(groups);
+
+            CountNode* tail = min;
+            for(uint32_t i = 0;i < groups;++i){
+                CountNode* pCount = countPool->New();
+                uint32_t number;
+                ar.Value(pCount->ID);
+                ar.Value(number);
+                tail->Connect(tail, pCount);
+                tail = pCount;
+
+                DataNode* last = nullptr;
+                for(uint32_t j = 0;j < number;++j){
+                    DATA_TYPE data;
+                    ar.Value(data);
+                    DataNode* pData = dataPool->New(data);
+                    pData->pCount = pCount;
+                    if(last)
+                        pData->Connect(last, pData);
+                    else
+                        pCount->pData = pData;
+                    last = pData;
+                    mp->Insert(data, pData);
+                }
+            }
+        }
+    }
+
+private:
+    NodePool<DataNode>* dataPool = nullptr;
+    NodePool<CountNode>* countPool = nullptr;
+
+    /*
+     * SS_Replace holds one data node beyond SIZE for a moment; besides the min
+     * sentinel there is one count node per distinct count, plus one for a move
+     * that creates a count before it empties the old one.
+     */
+    void Allocate(){
+        dataPool = new NodePool<DataNode>(SIZE + 1);
+        countPool = new NodePool<CountNode>(SIZE + 3);
+        min = countPool->New();
     }
 };
 
@@ -1,18 +1,238 @@
 #include "BenchMark.h"
 
+typedef std::map<std::string, std::string> Options;
+
+std::string GetOption(const Options& options, const std::string& key, const std::string& value) {
+    auto it = options.find(key);
+    return (it == options.end()) ? value : it->second;
+}
+
+/* Comma-separated list; empty for an empty value */
+std::vector<std::string> Split(const std::string& value) {
+    std::vector<std::string> ret;
+    size_t begin = 0;
+    while(begin < value.size()) {
+        size_t end = value.find(',', begin);
+        if(end == std::string::npos)
+            end = value.size();
+        ret.push_back(value.substr(begin, end - begin));
+        begin = end + 1;
+    }
+    return ret;
+}
+
 int main(int argc, char *argv[]) {
-    if (argc < 4) {
-        std::cerr << "Usage: " << argv[0] << "./CPU <memory> <threshold> <dataset1> <dataset2> ...\n";
+    Options options;
+    std::vector<std::string> args;
+
+    for(int32_t i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if(arg.compare(0, 2, "--") == 0) {
+            size_t eq = arg.find('=');
+            if(eq == std::string::npos)
+                options[arg.substr(2)] = "1";
+            else
+                options[arg.substr(2, eq - 2)] = arg.substr(eq + 1);
+        }
+        else {
+            args.push_back(arg);
+        }
+    }
+
+    uint64_t generate = std::stoull(GetOption(options, "generate", "0"));
+    if (args.size() < (generate ? 2 : 3)) {
+        std::cerr << "Usage: " << argv[0] << " [options] <memory> <threshold> <dataset1> <dataset2> ...\n"
+                  << "       " << argv[0] << " [options] --generate=<packets> <memory> <threshold>\n"
+                  << "Options:\n"
+                  << "    --bench=<name>             hh, window, epoch, snapshot, counter, geometry, alloc, zerokey, gsum,\n"
+                  << "                               distinct, distribution, spreader, batch, dispatch, multikey, hhh,\n"
+                  << "                               change, weighted, concurrent, aggregate, repeat, sweep, tune or\n"
+                  << "                               stream (default: hh)\n"
+                  << "    --format=<name>            dataset records: tuples (13 bytes) or weighted (tuple + uint16 length)\n"
+                  << "    --key=<name>               hh key: 5tuple, ipv6, pair or src (default: 5tuple)\n"
+                  << "    --window=<packets>         sliding window length (default: 1000000)\n"
+                  << "    --subwindow=<count>        sub-epochs per window (default: 8)\n"
+                  << "    --epoch=<packets>          epoch length for epoch and change (default: 1000000)\n"
+                  << "    --threads=<count>          concurrent, aggregate and distribution: largest thread count, doubling\n"
+                  << "                               from 1 (default: 32, 4 and hardware threads)\n"
+                  << "    --sets=<count>             aggregate: 8-way sets in the per-thread buffer (default: 64)\n"
+                  << "    --flush=<packets>          aggregate: flush the buffer every so many packets, 0 never (default: 4096)\n"
+                  << "    --registers=<count>        distinct: HyperLogLog registers, a power of two (default: 4096)\n"
+                  << "    --parts=<count>            distinct: estimators merged into one (default: 4)\n"
+                  << "    --fanout=<count>           spreader: distinct destinations that make a super-spreader (default: 100)\n"
+                  << "    --rounds=<count>           distribution: most EM rounds (default: 20)\n"
+                  << "    --budget=<ms>              distribution: stop the EM after this long, 0 never (default: 0)\n"
+                  << "    --seed=<n>                 hash seed and random stream of every sketch (default: 0)\n"
+                  << "    --repeat=<runs>            repeat: seeds per sketch, run in parallel (default: 10)\n"
+                  << "    --memories=<list>          sweep and batch: comma-separated memories (default: <memory>, and\n"
+                  << "                               <memory>,32000000,512000000 for batch)\n"
+                  << "    --thresholds=<list>        sweep: comma-separated thresholds (default: <threshold>)\n"
+                  << "    --sketches=<list>          sweep and batch: comma-separated sketch names (default: all registered)\n"
+                  << "    --seeds=<count>            sweep: seeds per configuration (default: 1)\n"
+                  << "    --workers=<count>          sweep: accuracy runs at a time (default: hardware threads)\n"
+                  << "    --throughput=<0|1>         sweep: also time each sketch and memory alone (default: 1)\n"
+                  << "    --sketch=<name>            tune: sketch to tune, <memory> is the largest memory tried (default: CocoSketch)\n"
+                  << "    --sample=<packets>         tune: trace prefix to tune on (default: 1000000)\n"
+                  << "    --f1=<score>               tune: smallest acceptable F1 (default: 0.9)\n"
+                  << "    --are=<error>              tune: largest acceptable ARE (default: inf)\n"
+                  << "    --min-memory=<bytes>       tune: smallest memory tried (default: 1000)\n"
+                  << "    --tolerance=<ratio>        tune: stop bisecting the memory at this relative gap (default: 0.05);\n"
+                  << "                               distribution: stop once a round moves less than this share of the\n"
+                  << "                               flows (default: 0.001)\n"
+                  << "    --generate=<packets>       run on a synthetic trace of this many packets instead of datasets;\n"
+                  << "                               stream: feed it to the sketch without holding it in memory\n"
+                  << "    --flows=<count>            generate: flows of the trace (default: 1000000)\n"
+                  << "    --skew=<s>                 generate: Zipf exponent of the flow sizes, 0 uniform (default: 1)\n"
+                  << "    --burst=<packets>          generate: mean length of a train of one flow (default: 1)\n"
+                  << "    --churn=<packets>          generate: reshuffle flow popularity this often, 0 never (default: 0)\n"
+                  << "    --spread=<flows>           generate: consecutive flows that share a source address (default: 1)\n"
+                  << "    --subnets=<count>          generate: skewed /16 networks the sources lie in, 0 anywhere (default: 0)\n"
+                  << "    --output=<path>            generate: write the trace to <path> as a dataset and exit\n"
+                  << "    --snapshot=<path>          snapshot file to write and reopen, plus <path>.z (default: sketch.snapshot)\n";
         return 1;
     }
 
-    uint32_t memory = std::stoi(argv[1]);
-    double threshold = std::stod(argv[2]);
+    uint32_t memory = std::stoi(args[0]);
+    double threshold = std::stod(args[1]);
+    std::string bench = GetOption(options, "bench", "hh");
+    int32_t status = 0;
+
+    std::cout << "Kernels: " << CpuKernels().name << std::endl;
+
+    std::vector<std::string> paths(args.begin() + 2, args.end());
+    std::unique_ptr<Generator> generator;
+    uint32_t threads = std::max(1u, std::thread::hardware_concurrency());
+    if(generate) {
+        uint32_t seed = std::stoul(GetOption(options, "seed", "0"));
+        generator.reset(new Generator(std::stoull(GetOption(options, "flows", "1000000")), std::stod(GetOption(options, "skew", "1")),
+                                      std::stod(GetOption(options, "burst", "1")), std::stoull(GetOption(options, "churn", "0")),
+                                      std::stoull(GetOption(options, "spread", "1")), std::stoull(GetOption(options, "subnets", "0")), seed));
+        std::cout << "Synthetic: " << generate << " packets, " << GetOption(options, "flows", "1000000") << " flows, skew "
+                  << GetOption(options, "skew", "1") << ", burst " << GetOption(options, "burst", "1") << ", churn "
+                  << GetOption(options, "churn", "0") << ", spread " << GetOption(options, "spread", "1") << ", subnets "
+                  << GetOption(options, "subnets", "0") << ", seed " << seed << std::endl;
+
+        if(options.count("output")) {
+            generator->Write(options["output"], generate, threads);
+            return 0;
+        }
+        if(bench == "stream") {
+            BenchMark::StreamBench(*generator, generate, threads, memory, threshold, seed);
+            return 0;
+        }
+        paths = {"Synthetic"};
+    }
+
+    for(auto& path : paths) {
+        std::cout << path << std::endl;
+        std::unique_ptr<BenchMark> loaded(generate ? new BenchMark(*generator, generate, threads, "Synthetic")
+                                                   : new BenchMark(path, "Dataset", GetOption(options, "format", "tuples") == "weighted"));
+        BenchMark& dataset = *loaded;
+        dataset.Seed(std::stoul(GetOption(options, "seed", "0")));
 
-    for(uint32_t i = 3; i < argc; ++i) {
-        std::cout << argv[i] << std::endl;
-        BenchMark dataset(argv[i], "Dataset");
-        dataset.HHBench(memory, threshold);
+        if(bench == "window") {
+            uint64_t window = std::stoull(GetOption(options, "window", "1000000"));
+            uint32_t subWindow = std::stoi(GetOption(options, "subwindow", "8"));
+            dataset.WindowBench(memory, threshold, window, subWindow);
+        }
+        else if(bench == "snapshot") {
+            dataset.SnapshotBench(memory, threshold, GetOption(options, "snapshot", "sketch.snapshot"));
+        }
+        else if(bench == "sweep") {
+            std::vector<uint32_t> memories;
+            std::vector<double> thresholds;
+            for(auto& value : Split(GetOption(options, "memories", args[0])))
+                memories.push_back(std::stoi(value));
+            for(auto& value : Split(GetOption(options, "thresholds", args[1])))
+                thresholds.push_back(std::stod(value));
+            uint32_t workers = std::stoi(GetOption(options, "workers", std::to_string(std::max(1u, std::thread::hardware_concurrency()))));
+            dataset.SweepBench(memories, thresholds, Split(GetOption(options, "sketches", "")),
+                               std::stoi(GetOption(options, "seeds", "1")), workers, GetOption(options, "throughput", "1") != "0");
+        }
+        else if(bench == "tune") {
+            dataset.TuneBench(GetOption(options, "sketch", "CocoSketch"), threshold, std::stoull(GetOption(options, "sample", "1000000")),
+                              std::stod(GetOption(options, "f1", "0.9")), std::stod(GetOption(options, "are", "inf")),
+                              std::stoi(GetOption(options, "min-memory", "1000")), memory, std::stod(GetOption(options, "tolerance", "0.05")));
+        }
+        else if(bench == "repeat") {
+            dataset.RepeatBench(memory, threshold, std::stoi(GetOption(options, "repeat", "10")));
+        }
+        else if(bench == "aggregate") {
+            dataset.AggregateBench(memory, threshold, std::stoi(GetOption(options, "sets", "64")),
+                                   std::stoull(GetOption(options, "flush", "4096")), std::stoi(GetOption(options, "threads", "4")));
+        }
+        else if(bench == "concurrent") {
+            dataset.ConcurrentBench(memory, threshold, std::stoi(GetOption(options, "threads", "32")));
+        }
+        else if(bench == "weighted") {
+            dataset.WeightedBench(memory, threshold);
+        }
+        else if(bench == "change") {
+            uint64_t epoch = std::stoull(GetOption(options, "epoch", "1000000"));
+            dataset.HeavyChangeBench(memory, threshold, epoch);
+        }
+        else if(bench == "hhh") {
+            if(!dataset.HHHBench(memory, threshold))
+                status = 1;
+        }
+        else if(bench == "multikey") {
+            dataset.MultiKeyBench(memory, threshold);
+        }
+        else if(bench == "distinct") {
+            dataset.CardinalityBench(memory, std::stoi(GetOption(options, "registers", "4096")), std::stoi(GetOption(options, "parts", "4")));
+        }
+        else if(bench == "dispatch") {
+            if(!dataset.DispatchBench())
+                status = 1;
+        }
+        else if(bench == "batch") {
+            std::vector<uint32_t> memories;
+            for(auto& value : Split(GetOption(options, "memories", args[0] + ",32000000,512000000")))
+                memories.push_back(std::stoi(value));
+            if(!dataset.QueryBatchBench(memories, threshold, Split(GetOption(options, "sketches", ""))))
+                status = 1;
+        }
+        else if(bench == "spreader") {
+            if(!dataset.SpreaderBench(memory, std::stoi(GetOption(options, "fanout", "100"))))
+                status = 1;
+        }
+        else if(bench == "distribution") {
+            uint32_t threads = std::stoi(GetOption(options, "threads", std::to_string(std::max(1u, std::thread::hardware_concurrency()))));
+            dataset.DistributionBench(memory, threads, std::stoi(GetOption(options, "rounds", "20")),
+                                      std::stod(GetOption(options, "tolerance", "0.001")), std::stod(GetOption(options, "budget", "0")));
+        }
+        else if(bench == "gsum") {
+            dataset.GSumBench(memory);
+        }
+        else if(bench == "zerokey") {
+            if(!dataset.ZeroKeyBench(memory))
+                status = 1;
+        }
+        else if(bench == "alloc") {
+            if(!dataset.AllocationBench(memory, threshold))
+                status = 1;
+        }
+        else if(bench == "geometry") {
+            dataset.GeometryBench(memory, threshold);
+        }
+        else if(bench == "counter") {
+            dataset.CounterBench(memory, threshold);
+        }
+        else if(bench == "epoch") {
+            uint64_t epoch = std::stoull(GetOption(options, "epoch", "1000000"));
+            dataset.EpochBench(memory, threshold, epoch);
+        }
+        else {
+            std::string key = GetOption(options, "key", "5tuple");
+            if(key == "ipv6")
+                dataset.KeyBench<TUPLES6>(memory, threshold, [](const TUPLES& t) { return TUPLES6::FromV4(t); });
+            else if(key == "pair")
+                dataset.KeyBench<SRC_DST>(memory, threshold, [](const TUPLES& t) { return (SRC_DST)t.srcIP_dstIP(); });
+            else if(key == "src")
+                dataset.KeyBench<SRC_IP>(memory, threshold, [](const TUPLES& t) { return (SRC_IP)t.srcIP(); });
+            else
+                dataset.HHBench(memory, threshold);
+        }
     }
-    return 0;
+    return status;
 }